@@ -0,0 +1,78 @@
+/**
+ * @file burstCapture.h
+ * @author agent (agent@local)
+ * @brief Event-triggered high rate capture of a small register block
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * A watch job reads a block of float32 registers (ABCD) every watch period and keeps the last
+ * samples in a ring. When a trigger fires the job polls with the capture window spread over the
+ * trace length (at most as fast as the bus allows), then the trace (ring + window) is published
+ * as one binary message:
+ *
+ *   u8 version (1), u8 trigger, u8 unit, u16 addr, u8 channels, u16 samples, u16 preSamples,
+ *   u32 trigger time (epoch s, 0 if the clock is not set), u16 trigger time (ms part),
+ *   per sample: zigzag varint time delta (ms, the first one relative to the trigger),
+ *               per channel a zigzag varint delta of the value in 1/1000 units.
+ *
+ * Multi byte header fields are little endian.
+ */
+#ifndef BURSTCAPTURE_H
+#define BURSTCAPTURE_H
+
+// --- Includes ---
+#include <Arduino.h>
+#include "espIOTLibSched.h"
+#include "mbGateway.h"
+
+// --- Defines ---
+#define BURST_MAX_CHANNELS 8
+#define BURST_MAX_TRIGGERS 4
+// Samples kept from before the trigger
+#ifndef BURST_PRE_SAMPLES
+    #define BURST_PRE_SAMPLES 16
+#endif
+// Trace length including the pre trigger samples, about what fits into one MQTT message
+#ifndef BURST_MAX_SAMPLES
+    #define BURST_MAX_SAMPLES 128
+#endif
+// Shortest period while capturing, the SKIP policy turns this into "as fast as the bus answers".
+// Longer windows are sampled slower, so the whole window fits into the trace
+#define BURST_CAPTURE_MIN_PERIOD_MS 10
+#define BURST_WATCH_PERIOD_MS 1000
+#define BURST_WINDOW_MS 10000
+// Imbalance triggers need at least this mean (channel units, A for the phase currents). Near
+// zero load any difference is a large percentage of the mean
+#define BURST_IMBALANCE_MIN_MEAN 1.0f
+// No new trigger for this long after a capture was sent
+#define BURST_HOLDOFF_MS 60000
+#define BURST_FORMAT_VERSION 1
+#define BURST_NO_TRIGGER 0xFF
+
+// --- Marcos ---
+
+// --- Typedefs ---
+typedef enum {
+    BURST_TRIG_ABOVE,      // Any channel above level
+    BURST_TRIG_RATE,       // Any channel changing faster than level per second
+    BURST_TRIG_IMBALANCE   // (max - min) of the channels above level % of their mean, see BURST_IMBALANCE_MIN_MEAN
+} burstTrigType;
+
+typedef struct {
+    uint8_t type;          // burstTrigType
+    uint8_t channel;       // First channel
+    uint8_t channels;      // Number of channels checked
+    float level;           // 0 disables the trigger
+} burstTrigger;
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+void burstBegin(const char *topic, mbGatewayReadFn readFn, espIOTLibSched *sched, uint8_t unit, uint16_t addr, uint8_t channels, burstTrigger *triggers, uint8_t triggerCount);
+void burstSetTiming(uint32_t watchPeriod, uint32_t window);
+bool burstActive();
+void burstMetrics(const char *prefix);
+
+#endif /* BURSTCAPTURE_H */
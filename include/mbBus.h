@@ -0,0 +1,73 @@
+/**
+ * @file mbBus.h
+ * @author agent (agent@local)
+ * @brief Independent Modbus RTU buses, each polled by its own task and scheduler
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * Every bus owns a UART, a ModbusRTU instance and a mutex, so transactions on different buses
+ * overlap. Each bus has a task that polls the devices added with mbBusAddDevice() and runs reads
+ * queued with mbBusSubmit(). The results travel through a queue to the loop task, which fills the
+ * register cache and hands them to the result callback (MQTT publishing stays on the loop task).
+ * Unit ids must be unique across buses: reads by unit id (mbBusReadUnit) go to the bus the unit
+ * was added to with mbBusAddUnit / mbBusAddDevice.
+ */
+#ifndef MBBUS_H
+#define MBBUS_H
+
+// --- Includes ---
+#include <Arduino.h>
+
+// --- Defines ---
+// The ESP32-S2 has two UARTs
+#ifndef MB_BUS_MAX
+    #define MB_BUS_MAX 2
+#endif
+#ifndef MB_BUS_MAX_DEVICES
+    #define MB_BUS_MAX_DEVICES 4
+#endif
+// Registers per polled block
+#define MB_BUS_MAX_REGS 32
+#define MB_BUS_QUEUE_LEN 16
+// Submitted reads waiting per bus
+#define MB_BUS_REQUEST_QUEUE_LEN 32
+// Longest wait of a bus task without due polls
+#define MB_BUS_IDLE_MAX_MS 1000
+#define MB_BUS_TASK_STACK 4096
+#define MB_BUS_TASK_PRIORITY 1
+
+// --- Marcos ---
+
+// --- Typedefs ---
+typedef struct {
+    uint8_t bus;
+    uint8_t unit;
+    uint8_t fc;
+    uint16_t addr;
+    uint16_t count;
+    uint8_t exception;  // 0 or Modbus exception code, data is only valid for 0
+    uint32_t stamp;     // millis() of the read
+    uint32_t tag;       // As given to mbBusSubmit(), 0 for polled devices
+    uint8_t data[2 * MB_BUS_MAX_REGS];
+} mbBusResult;
+
+typedef void (*mbBusResultCB)(const mbBusResult *result);
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+int8_t mbBusAdd(const char *name, HardwareSerial *serial, int8_t rxPin, int8_t txPin, int8_t dePin, uint32_t baud, uint32_t config);
+int8_t mbBusAddUnit(uint8_t bus, uint8_t unit);
+int8_t mbBusAddDevice(uint8_t bus, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint32_t period);
+uint32_t mbBusSerialConfig(const char *format);
+const char *mbBusName(uint8_t bus);
+void mbBusStart(mbBusResultCB resultCB);
+int8_t mbBusSubmit(uint8_t bus, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint32_t tag);
+uint8_t mbBusRead(uint8_t bus, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *data);
+uint8_t mbBusReadUnit(uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *data);
+void mbBusLoop();
+void mbBusMetrics(const char *prefix);
+
+#endif /* MBBUS_H */
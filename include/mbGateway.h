@@ -0,0 +1,58 @@
+/**
+ * @file mbGateway.h
+ * @author agent (agent@local)
+ * @brief Modbus TCP server answering FC03 / FC04 reads from the register cache
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef MBGATEWAY_H
+#define MBGATEWAY_H
+
+// --- Includes ---
+#include <Arduino.h>
+
+// --- Defines ---
+#ifndef MB_GATEWAY_PORT
+    #define MB_GATEWAY_PORT 502
+#endif
+#ifndef MB_GATEWAY_MAX_CLIENTS
+    #define MB_GATEWAY_MAX_CLIENTS 4
+#endif
+// Idle TCP connections are closed after this
+#ifndef MB_GATEWAY_CLIENT_TIMEOUT_MS
+    #define MB_GATEWAY_CLIENT_TIMEOUT_MS 60000
+#endif
+// Default for the maximum age of cached registers served to TCP clients
+#ifndef MB_GATEWAY_MAX_AGE_MS
+    #define MB_GATEWAY_MAX_AGE_MS 5000
+#endif
+// Modbus TCP unit id for "this device", served from the unit given to mbGatewayBegin()
+#define MB_GATEWAY_UNIT_THIS 0xFF
+// Largest read allowed by the Modbus spec
+#define MB_GATEWAY_MAX_REGS 125
+
+// Modbus exception codes
+#define MB_EX_ILLEGAL_FUNCTION 0x01
+#define MB_EX_ILLEGAL_DATA_ADDRESS 0x02
+#define MB_EX_ILLEGAL_DATA_VALUE 0x03
+#define MB_EX_SERVER_FAILURE 0x04
+#define MB_EX_GATEWAY_TARGET 0x0B
+
+// --- Marcos ---
+
+// --- Typedefs ---
+// Read count registers from the RTU bus into data (big endian), returns 0 or a Modbus exception code
+typedef uint8_t (*mbGatewayReadFn)(uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *data);
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+void mbGatewayBegin(mbGatewayReadFn readFn, uint8_t unit);
+void mbGatewaySetMaxAge(uint32_t maxAge);
+void mbGatewayLoop();
+void mbGatewayMetrics(const char *prefix);
+
+#endif /* MBGATEWAY_H */
@@ -0,0 +1,43 @@
+/**
+ * @file mqttCommands.h
+ * @author agent (agent@local)
+ * @brief On-demand register reads and poll rate changes via MQTT
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * Commands are flat JSON objects on the command topic, replies carry the same "id":
+ *   {"id":"42","cmd":"read","addr":"0x5012","count":2}         (optional "unit", "fc")
+ *   {"id":"43","cmd":"poll","period":1000,"duration":300}       (ms, s; period 0 restores the default)
+ */
+#ifndef MQTTCOMMANDS_H
+#define MQTTCOMMANDS_H
+
+// --- Includes ---
+#include <Arduino.h>
+#include "espIOTLibSched.h"
+#include "mbGateway.h"
+
+// --- Defines ---
+#ifndef MQTT_CMD_QUEUE_LEN
+    #define MQTT_CMD_QUEUE_LEN 4
+#endif
+#define MQTT_CMD_ID_LEN 32
+// Registers per read command
+#define MQTT_CMD_MAX_REGS 64
+// Limits for the fast poll command
+#define MQTT_CMD_MIN_PERIOD_MS 1000
+#define MQTT_CMD_MAX_DURATION_S 3600
+
+// --- Marcos ---
+
+// --- Typedefs ---
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+void mqttCmdBegin(const char *cmdTopic, const char *replyTopic, mbGatewayReadFn readFn, espIOTLibSched *sched, int8_t pollJob, uint32_t pollPeriod);
+void mqttCmdLoop();
+
+#endif /* MQTTCOMMANDS_H */
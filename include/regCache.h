@@ -0,0 +1,35 @@
+/**
+ * @file regCache.h
+ * @author agent (agent@local)
+ * @brief Cache of raw Modbus registers read from the RTU side
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef REGCACHE_H
+#define REGCACHE_H
+
+// --- Includes ---
+#include <Arduino.h>
+
+// --- Defines ---
+// Number of cached registers, must be a power of two
+#ifndef REG_CACHE_SIZE
+    #define REG_CACHE_SIZE 256
+#endif
+// Entries probed per lookup before the oldest one is replaced
+#define REG_CACHE_PROBE 8
+
+// --- Marcos ---
+
+// --- Typedefs ---
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+void regCacheStore(uint8_t unit, uint8_t fc, uint16_t addr, const uint8_t *data, uint16_t count);
+bool regCacheLoad(uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint32_t maxAge, uint8_t *data);
+
+#endif /* REGCACHE_H */
@@ -0,0 +1,54 @@
+/**
+ * @file regDecode.h
+ * @author agent (agent@local)
+ * @brief Decode typed values from a block of raw Modbus registers
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef REGDECODE_H
+#define REGDECODE_H
+
+// --- Includes ---
+#include <stdint.h>
+
+// --- Defines ---
+
+// --- Marcos ---
+
+// --- Typedefs ---
+typedef enum {
+    REG_TYPE_UINT16,
+    REG_TYPE_INT16,
+    REG_TYPE_UINT32,
+    REG_TYPE_INT32,
+    REG_TYPE_FLOAT32,
+    REG_TYPE_UINT64   // e.g. energy counters
+} regType;
+
+// Byte order of a value, A is the most significant byte. Registers arrive big endian on the wire
+typedef enum {
+    REG_ORDER_ABCD,   // Big endian, high word first
+    REG_ORDER_CDAB,   // Word swapped (low word first)
+    REG_ORDER_BADC,   // Bytes swapped within each word
+    REG_ORDER_DCBA    // Little endian
+} regOrder;
+
+typedef struct {
+    uint16_t offset;  // First register of the value, relative to the block start
+    uint8_t type;     // regType
+    uint8_t order;    // regOrder
+    float scale;      // Decoded value is multiplied by this
+} regDesc;
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+uint8_t regDecodeWidth(uint8_t type);
+void regDecode(const uint8_t *block, uint16_t blockRegs, const regDesc *desc, uint16_t count, double *values);
+void regDecodeFloat32(const uint8_t *block, uint16_t count, uint8_t order, float *values);
+void regDecodeFloat32Gather(const uint8_t *block, const uint16_t *offsets, uint16_t count, uint8_t order, float *values);
+
+#endif /* REGDECODE_H */
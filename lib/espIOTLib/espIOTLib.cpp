@@ -23,9 +23,15 @@
 #  include <WiFi.h>
    // For ESP32 IotWebConf provides a drop-in replacement for UpdateServer.
 #  include <IotWebConfESP32HTTPUpdateServer.h>
+#  include <esp_pm.h>
+#  include <lwip/sockets.h>
+#  include <lwip/dns.h>
+#  include <lwip/tcpip.h>
 # endif
 #include <IotWebConfUsing.h> // This loads aliases for easier class names.
 #include <MQTT.h>
+#include <atomic>
+#include <new>
 
 // --- Defines ---
 #ifdef ESP8266
@@ -40,30 +46,48 @@
 #define ESP_IOTLIB_STATUS_ENDPOINT "/status"
 #define ESP_IOTLIB_RESET_ENDPOINT "/reset"
 #define ESP_IOTLIB_MQTT_RECONNECT_ENDPOINT "/mqttReconnect"
+#define ESP_IOTLIB_METRICS_ENDPOINT "/metrics"
+#define ESP_IOTLIB_LOG_ENDPOINT "/log"
 
 #define IP_ADDRESS_BUFFER_LEN 128
 
-#ifdef ESP_IOTLIB_MQTT_LOG
-    #define LOG_MQTT_IDENT "[m] "
-    #define MQTT_LOGF(...) Serial.print(LOG_MQTT_IDENT);Serial.printf(__VA_ARGS__)
-#else
-    #define MQTT_LOGF(...)
-#endif
-#ifdef ESP_IOTLIB_IOT_LOG
-    #define LOG_IOT_IDENT "[i] "
-    #define IOT_LOGF(...) Serial.print(LOG_IOT_IDENT);Serial.printf(__VA_ARGS__)
-#else
-    #define IOT_LOGF(...)
-#endif
+#define LOG_MQTT_IDENT "[m] "
+#define MQTT_LOGF(format, ...) ESP_IOTLIB_LOGD(LOG_MQTT_IDENT format, ##__VA_ARGS__)
+#define LOG_IOT_IDENT "[i] "
+#define IOT_LOGF(format, ...) ESP_IOTLIB_LOGD(LOG_IOT_IDENT format, ##__VA_ARGS__)
 // --- Marcos ---
 
 // --- Typedefs ---
+typedef enum {
+    MQTT_STATE_IDLE,        // MQTT disabled or no WiFi
+    MQTT_STATE_BACKOFF,     // Waiting for the next attempt
+    MQTT_STATE_RESOLVING,   // Asynchronous DNS lookup of the server in progress
+    MQTT_STATE_CONNECTING,  // Non-blocking TCP connect in progress
+    MQTT_STATE_CONNECTED
+} espIOTLibMQTTState;
+
+typedef struct {
+    std::atomic<uint32_t> seq; // Sequence number of the line stored here
+    uint16_t len;
+    char text[ESP_IOTLIB_LOG_LINE_LEN];
+} espIOTLibLogSlot;
+
+typedef struct {
+    uint32_t time;
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    uint32_t largestBlock;
+} espIOTLibHeapSample;
 
 // --- Private Vars ---
     // IOTWeb
 static DNSServer dnsServer;
 static WebServer *localServer;
 static IotWebConf *iotWebConf;
+#ifdef ESP_IOTLIB_STATIC_ALLOC
+alignas(WebServer) static uint8_t localServerStorage[sizeof(WebServer)];
+alignas(IotWebConf) static uint8_t iotWebConfStorage[sizeof(IotWebConf)];
+#endif
 #ifdef ESP8266
 static ESP8266HTTPUpdateServer httpUpdater;
 #elif defined(ESP32)
@@ -100,24 +124,70 @@ static IotWebConfPasswordParameter mqttUserPasswordParam = IotWebConfPasswordPar
 static MQTTClient mqttClient(ESP_IOTLIB_MQTT_BUFFER_SIZE);
 static char mqttDataBuffer[ESP_IOTLIB_MQTT_DATA_BUFFER_LEN];
 static uint32_t mqttFloatPrecision = 3;
-static uint32_t mqttLastConnectFailTime = 0;
+static espIOTLibMQTTState mqttState = MQTT_STATE_IDLE;
+static uint32_t mqttNextAttempt = 0;
+static uint32_t mqttConnectStart = 0;
+static uint8_t mqttFailures = 0;       // Consecutive failed attempts, drives the backoff
+static uint32_t mqttConnectAttempts = 0;
+static uint32_t mqttConnectFailures = 0;
+static uint32_t mqttConnectLatency = 0; // ms, TCP connect start until CONNACK
+#if defined(ESP32)
+static int mqttSocket = -1;
+static std::atomic<uint32_t> mqttDnsLookup(0); // Attempt the pending lookup belongs to, 0 = none
+static std::atomic<uint32_t> mqttDnsDone(0);   // Attempt whose lookup finished
+static std::atomic<uint32_t> mqttDnsAddr(0);   // Its result, 0 if the name was not found
+static char mqttDnsName[ESP_IOTLIB_MQTT_TOPIC_BUFFER_LEN]; // Name being looked up, read on the lwIP thread
+#endif
+static uint32_t mqttPublishCount = 0;
+static uint32_t mqttPublishFailures = 0;
+static char mqttMsgPool[ESP_IOTLIB_MQTT_POOL_SLOTS][ESP_IOTLIB_MQTT_BUFFER_SIZE];
+static std::atomic<bool> mqttMsgPoolUsed[ESP_IOTLIB_MQTT_POOL_SLOTS];
+static uint32_t mqttMsgPoolExhausted = 0;
+static const char *mqttSubscriptions[ESP_IOTLIB_MQTT_MAX_SUBSCRIPTIONS];
+static uint8_t mqttSubscriptionCount = 0;
 
     // OTA update
 static bool doOTAUpdate = false;
 
-// --- Private Functions ---
-void espIOTLibMQTTConnect(){
-    // Attempt to connect
-    if (!mqttClient.connect(iotWebConf->getThingName(), mqttUserName, mqttUserPassword)) {
-        MQTT_LOGF("Could not connect to MQTT server!!\n");
-        MQTT_LOGF(" -- Connect return: %d // Error: %d, try again in 5 seconds.\n", mqttClient.returnCode(), mqttClient.lastError());
-        mqttLastConnectFailTime = millis();
-    } else {
-        MQTT_LOGF("Connected to MQTT\n");
-        mqttLastConnectFailTime = 0;
-    }
-}
+    // Power
+static bool doPowerSave = false;
+#if defined(ESP32)
+static TaskHandle_t idleTask = NULL;
+#endif
+static uint32_t lastActivity = 0;
+static uint32_t dutyWindowStart = 0; // micros
+static uint32_t dutyIdleTime = 0;    // micros
+static float dutyCycle = 100.0;
+static uint32_t loopWakeTime = 0;    // micros
+static uint32_t loopTime = 0;        // micros, awake part of the last loop pass
+static uint32_t loopTimeMax = 0;     // micros, since last scrape
+static bool idleStarted = false;     // Timing starts with the first idle call, not at boot
+
+    // Streamed responses
+static char chunkBuffer[ESP_IOTLIB_CHUNK_LEN];
+static size_t chunkLen = 0;
+static uint32_t chunkTruncated = 0; // ChunkPrintf calls longer than a chunk
 
+    // Metrics
+static espIOTLibMetricsCB metricsCB;
+
+    // Heap tracking
+static espIOTLibHeapSample heapHistory[ESP_IOTLIB_HEAP_HISTORY];
+static uint8_t heapHistoryNext = 0;
+static uint8_t heapHistoryCount = 0;
+static uint32_t heapLastSample = 0;
+static uint32_t heapLargestBlockMin = UINT32_MAX;
+static const char *heapReportTopic = NULL;
+
+    // Log
+static espIOTLibLogSlot logSlots[ESP_IOTLIB_LOG_SLOTS];
+static std::atomic<uint32_t> logHead(1);  // Next sequence number to hand out
+static uint32_t logSerialSeq = 1;         // Next line to drain to Serial
+static uint16_t logSerialOffset = 0;
+static uint32_t logDropped = 0;
+static const char logLevelChars[] = "-EWID";
+
+// --- Private Functions ---
 const char* espIOTLibMQTTReturnToString(lwmqtt_return_code_t retval){
     switch (retval)
     {
@@ -175,22 +245,323 @@ const char* espIOTLibMQTTErrorToString(lwmqtt_err_t errval){
     }
 }
 
-// Reconnect to MQTT server
-void espIOTLibReconnectMQTT(){
-    // Loop until we're reconnected
-    if(doMqtt && connectedToWifi && !mqttClient.connected() && (mqttLastConnectFailTime - millis() > ESP_IOTLIB_MQTT_RECONNECT_INTERVAL)) {
-        MQTT_LOGF(" -- Connect return: %d // Error: %d, try again in 5 seconds.\n", mqttClient.returnCode(), mqttClient.lastError());
-        espIOTLibMQTTConnect();
+// Publish to MQTT if connected, keeps the publish counters
+void espIOTLibMQTTPublish(const char *topic, const char *payload){
+    mqttPublishCount++;
+    if (connectedToWifi && mqttClient.connected()){
+        if(mqttClient.publish(topic, payload)){
+            MQTT_LOGF("MQTT pub: %s: %s OK\n", topic, payload);
+        } else {
+            MQTT_LOGF("MQTT pub: %s: %s Failed!\n", topic, payload);
+            mqttPublishFailures++;
+        }
+    } else {
+        MQTT_LOGF("MQTT pub: %s: %s No Connection...\n", topic, payload);
+        mqttPublishFailures++;
+    }
+}
+
+// Record free / min free / largest block, optionally publish them
+void espIOTLibHeapSampleNow(){
+    espIOTLibHeapSample *sample = &heapHistory[heapHistoryNext];
+    sample->time = millis();
+    sample->freeHeap = ESP.getFreeHeap();
+#ifdef ESP8266
+    sample->minFreeHeap = sample->freeHeap;
+    sample->largestBlock = ESP.getMaxFreeBlockSize();
+#elif defined(ESP32)
+    sample->minFreeHeap = ESP.getMinFreeHeap();
+    sample->largestBlock = ESP.getMaxAllocHeap();
+#endif
+    if(sample->largestBlock < heapLargestBlockMin){
+        heapLargestBlockMin = sample->largestBlock;
+    }
+    heapHistoryNext = (heapHistoryNext + 1) % ESP_IOTLIB_HEAP_HISTORY;
+    if(heapHistoryCount < ESP_IOTLIB_HEAP_HISTORY){
+        heapHistoryCount++;
+    }
+    heapLastSample = sample->time;
+
+    if(heapReportTopic){
+        char *msg = espIOTLibMQTTMsgAcquire();
+        if(msg){
+            snprintf(msg, ESP_IOTLIB_MQTT_BUFFER_SIZE, "{\"free\": %u,\"minFree\": %u,\"largest\": %u,\"largestMin\": %u}",
+                sample->freeHeap, sample->minFreeHeap, sample->largestBlock, heapLargestBlockMin);
+            espIOTLibMQTTPublish(heapReportTopic, msg);
+            espIOTLibMQTTMsgRelease(msg);
+        }
+    }
+}
+
+// Schedule the next attempt: exponential backoff with jitter (between half and full interval)
+void espIOTLibMQTTBackoff(){
+    uint32_t interval = ESP_IOTLIB_MQTT_RECONNECT_INTERVAL;
+    for(uint8_t i = 1; i < mqttFailures && interval < ESP_IOTLIB_MQTT_RECONNECT_MAX_INTERVAL; i++){
+        interval *= 2;
+    }
+    if(interval > ESP_IOTLIB_MQTT_RECONNECT_MAX_INTERVAL){
+        interval = ESP_IOTLIB_MQTT_RECONNECT_MAX_INTERVAL;
+    }
+    if(mqttFailures == 0){
+        interval = 0;
+    }
+    interval = interval / 2 + random(interval / 2 + 1);
+    mqttNextAttempt = millis() + interval;
+    mqttState = MQTT_STATE_BACKOFF;
+    MQTT_LOGF("Next MQTT attempt in %u ms\n", interval);
+}
+
+void espIOTLibMQTTFailed(const char *reason){
+    ESP_IOTLIB_LOGW(LOG_MQTT_IDENT "Could not connect to MQTT server: %s\n", reason);
+    MQTT_LOGF(" -- Connect return: %d // Error: %d\n", mqttClient.returnCode(), mqttClient.lastError());
+#if defined(ESP32)
+    if(mqttSocket >= 0){
+        close(mqttSocket);
+        mqttSocket = -1;
     }
+    // A late answer to the lookup is ignored
+    mqttDnsLookup = 0;
+#endif
+    mqttConnectFailures++;
+    if(mqttFailures < UINT8_MAX){
+        mqttFailures++;
+    }
+    espIOTLibMQTTBackoff();
+}
+
+#if defined(ESP32)
+// Runs on the lwIP thread when a lookup started by espIOTLibMQTTDnsStart() finishes
+void espIOTLibMQTTDnsCB(const char *name, const ip_addr_t *ipaddr, void *arg){
+    uint32_t attempt = (uint32_t)(uintptr_t)arg;
+    if(attempt != mqttDnsLookup){
+        return;
+    }
+    mqttDnsAddr = ipaddr ? ip4_addr_get_u32(ip_2_ip4(ipaddr)) : 0;
+    mqttDnsDone = attempt;
+}
+
+// Runs on the lwIP thread, the DNS client must not be called from other tasks
+void espIOTLibMQTTDnsStart(void *arg){
+    ip_addr_t dnsAddr;
+    err_t err = dns_gethostbyname(mqttDnsName, &dnsAddr, espIOTLibMQTTDnsCB, arg);
+    if(err == ERR_OK){
+        // Answered from the lwIP cache
+        espIOTLibMQTTDnsCB(mqttDnsName, &dnsAddr, arg);
+    } else if(err != ERR_INPROGRESS){
+        espIOTLibMQTTDnsCB(mqttDnsName, NULL, arg);
+    }
+}
+
+// Start a non-blocking TCP connect to the resolved server address
+void espIOTLibMQTTConnectTo(uint32_t addr){
+    mqttSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(mqttSocket < 0){
+        espIOTLibMQTTFailed("no socket");
+        return;
+    }
+    fcntl(mqttSocket, F_SETFL, fcntl(mqttSocket, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = addr;
+    serverAddr.sin_port = htons(ESP_IOTLIB_MQTT_PORT);
+    if(connect(mqttSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0 && errno != EINPROGRESS){
+        espIOTLibMQTTFailed("TCP connect failed");
+        return;
+    }
+    mqttState = MQTT_STATE_CONNECTING;
+}
+
+// Wait for the DNS answer, the connect timeout covers lookup and TCP connect together
+void espIOTLibMQTTPollResolve(){
+    if(mqttDnsDone != mqttConnectAttempts){
+        if(millis() - mqttConnectStart > ESP_IOTLIB_MQTT_CONNECT_TIMEOUT){
+            espIOTLibMQTTFailed("DNS lookup timeout");
+        }
+        return;
+    }
+    mqttDnsLookup = 0;
+    uint32_t addr = mqttDnsAddr;
+    if(!addr){
+        espIOTLibMQTTFailed("DNS lookup failed");
+        return;
+    }
+    espIOTLibMQTTConnectTo(addr);
+}
+#endif
+
+// Start resolving the server and the TCP connect, both complete in the background (ESP32 only)
+void espIOTLibMQTTStartConnect(){
+    mqttConnectAttempts++;
+    mqttConnectStart = millis();
+#if defined(ESP32)
+    IPAddress addr;
+    if(addr.fromString(mqttServer)){
+        espIOTLibMQTTConnectTo((uint32_t)addr);
+        return;
+    }
+    // The answer arrives through espIOTLibMQTTDnsCB(), espIOTLibMQTTPollResolve() picks it up
+    snprintf(mqttDnsName, sizeof(mqttDnsName), "%s", mqttServer);
+    mqttDnsLookup = mqttConnectAttempts;
+    if(tcpip_callback(espIOTLibMQTTDnsStart, (void *)(uintptr_t)mqttConnectAttempts) != ERR_OK){
+        espIOTLibMQTTFailed("DNS lookup failed");
+        return;
+    }
+    mqttState = MQTT_STATE_RESOLVING;
+#else
+    mqttState = MQTT_STATE_CONNECTING;
+#endif
+}
+
+// Check the pending TCP connect, then send CONNECT and wait for CONNACK. The wait blocks the loop
+// for up to ESP_IOTLIB_MQTT_CONNACK_TIMEOUT, MQTTClient has no way to poll for CONNACK.
+// On ESP8266 lookup, TCP connect and CONNACK all block here.
+void espIOTLibMQTTPollConnect(){
+#if defined(ESP32)
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(mqttSocket, &writeSet);
+    struct timeval noWait = {0, 0};
+    int ready = select(mqttSocket + 1, NULL, &writeSet, NULL, &noWait);
+    if(ready < 0){
+        espIOTLibMQTTFailed("select failed");
+        return;
+    }
+    if(ready == 0){
+        if(millis() - mqttConnectStart > ESP_IOTLIB_MQTT_CONNECT_TIMEOUT){
+            espIOTLibMQTTFailed("TCP connect timeout");
+        }
+        return;
+    }
+    int sockError = 0;
+    socklen_t sockErrorLen = sizeof(sockError);
+    getsockopt(mqttSocket, SOL_SOCKET, SO_ERROR, &sockError, &sockErrorLen);
+    if(sockError){
+        espIOTLibMQTTFailed("TCP connect refused");
+        return;
+    }
+    // Hand the connected socket to the client used by MQTTClient
+    fcntl(mqttSocket, F_SETFL, fcntl(mqttSocket, F_GETFL, 0) & ~O_NONBLOCK);
+    wifiClient = WiFiClient(mqttSocket);
+    mqttSocket = -1;
+    bool ok = mqttClient.connect(iotWebConf->getThingName(), mqttUserName, mqttUserPassword, true);
+#else
+    bool ok = mqttClient.connect(iotWebConf->getThingName(), mqttUserName, mqttUserPassword);
+#endif
+    if(!ok){
+        espIOTLibMQTTFailed(espIOTLibMQTTReturnToString(mqttClient.returnCode()));
+        return;
+    }
+    mqttConnectLatency = millis() - mqttConnectStart;
+    MQTT_LOGF("Connected to MQTT after %u ms\n", mqttConnectLatency);
+    mqttFailures = 0;
+    mqttState = MQTT_STATE_CONNECTED;
+    // Subscriptions do not survive a reconnect
+    for(uint8_t i = 0; i < mqttSubscriptionCount; i++){
+        mqttClient.subscribe(mqttSubscriptions[i]);
+    }
+}
+
+// MQTT connection state machine, see espIOTLibMQTTPollConnect() for the part that blocks
+void espIOTLibMQTTStep(){
+    if(!doMqtt || !connectedToWifi){
+        return;
+    }
+    switch(mqttState){
+    case MQTT_STATE_IDLE:
+        espIOTLibMQTTBackoff();
+        break;
+    case MQTT_STATE_BACKOFF:
+        if((int32_t)(millis() - mqttNextAttempt) >= 0){
+            espIOTLibMQTTStartConnect();
+        }
+        break;
+    case MQTT_STATE_RESOLVING:
+#if defined(ESP32)
+        espIOTLibMQTTPollResolve();
+#endif
+        break;
+    case MQTT_STATE_CONNECTING:
+        espIOTLibMQTTPollConnect();
+        break;
+    case MQTT_STATE_CONNECTED:
+        if(!mqttClient.connected()){
+            ESP_IOTLIB_LOGW(LOG_MQTT_IDENT "Connection lost, error: %s\n", espIOTLibMQTTErrorToString(mqttClient.lastError()));
+            wifiClient.stop();
+            espIOTLibMQTTBackoff();
+        }
+        break;
+    }
+}
+
+const char *espIOTLibMQTTStateToString(){
+    switch(mqttState){
+    case MQTT_STATE_IDLE:
+        return "Idle";
+    case MQTT_STATE_BACKOFF:
+        return "Waiting to reconnect";
+    case MQTT_STATE_RESOLVING:
+        return "Resolving server";
+    case MQTT_STATE_CONNECTING:
+        return "Connecting";
+    case MQTT_STATE_CONNECTED:
+        return "Connected";
+    default:
+        return "?";
+    }
+}
+
+#if defined(ESP32)
+// Any WiFi event ends the current idle slice early
+void espIOTLibWifiEventCB(arduino_event_id_t event){
+    if(idleTask)
+        xTaskNotifyGive(idleTask);
+}
+#endif
+
+// Configure modem sleep and, if the SDK was built with power management, automatic light sleep
+void espIOTLibApplyPowerSave(){
+#if defined(ESP32)
+    // Modem sleep keeps the association, the radio wakes up for DTIM beacons
+    WiFi.setSleep(WIFI_PS_MAX_MODEM);
+# if CONFIG_PM_ENABLE
+#  if CONFIG_IDF_TARGET_ESP32S2
+    esp_pm_config_esp32s2_t pmConfig;
+#  else
+    esp_pm_config_esp32_t pmConfig;
+#  endif
+    pmConfig.max_freq_mhz = ESP.getCpuFreqMHz();
+    pmConfig.min_freq_mhz = 40;
+#  if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    pmConfig.light_sleep_enable = true;
+#  else
+    pmConfig.light_sleep_enable = false;
+#  endif
+    if(esp_pm_configure(&pmConfig) != ESP_OK){
+        IOT_LOGF("Power management not available\n");
+    }
+# endif
+#elif defined(ESP8266)
+    WiFi.setSleepMode(WIFI_MODEM_SLEEP);
+#endif
 }
 
 void espIOTLibWifiConnectCB(){
     connectedToWifi = true;
     IOT_LOGF("Connected to WiFi \"%s\"\n", iotWebConf->getWifiAuthInfo().ssid);
+    if(doPowerSave){
+        IOT_LOGF("\tEnable modem sleep\n");
+        espIOTLibApplyPowerSave();
+    }
     if(doMqtt){
         MQTT_LOGF("\tAttempt connection to MQTT server!\n");
         mqttClient.begin(mqttServer, ESP_IOTLIB_MQTT_PORT, wifiClient);
-        espIOTLibMQTTConnect();
+        mqttClient.setTimeout(ESP_IOTLIB_MQTT_CONNACK_TIMEOUT);
+        if(mqttState == MQTT_STATE_RESOLVING || mqttState == MQTT_STATE_CONNECTING){
+            espIOTLibMQTTFailed("WiFi reconnected");
+        }
+        mqttFailures = 0;
+        espIOTLibMQTTBackoff();
     }
     if(doOTAUpdate){
         IOT_LOGF("\tStart ArduinoOTA\n");
@@ -207,11 +578,15 @@ void espIOTLibWifiConnectCB(){
     }
 }
 
+void espIOTLibIPToStr(IPAddress addr, char *str){
+    snprintf(str, IP_ADDRESS_BUFFER_LEN, "%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+}
+
 void espIOTLibConnectWifi(const char* ssid, const char* password){
-    ip.fromString(String(ipAddressValue));
-    mask.fromString(String(netmaskValue));
-    gateway.fromString(String(gatewayValue));
-    dns.fromString(String(dnsValue));
+    ip.fromString(ipAddressValue);
+    mask.fromString(netmaskValue);
+    gateway.fromString(gatewayValue);
+    dns.fromString(dnsValue);
 #ifdef ESP8266
     if (! WiFi.config(ip, dns, gateway, mask)) {
 #elif defined(ESP32)
@@ -223,6 +598,17 @@ void espIOTLibConnectWifi(const char* ssid, const char* password){
     WiFi.begin(ssid, password);
 }
 
+// Print an IP address into the response chunk
+void espIOTLibChunkIP(IPAddress addr){
+    espIOTLibChunkPrintf("%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+}
+
+void espIOTLibChunkMAC(){
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    espIOTLibChunkPrintf("%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
 /**
  * Handle web requests to "/" path.
  */
@@ -234,82 +620,36 @@ void handleRoot()
         // -- Captive portal request were already served.
         return;
     }
-    String s = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/>";
-    s += "<title>";
-    s += iotWebConf->getThingName();
-    s += " - Main</title></head><body><div><p>Main page of ";
-    s += iotWebConf->getThingName();
-    s += "</p><p>Using Chip: "; 
-    s += String(CHIP_IDENT);
+    espIOTLibChunkBegin("text/html");
+    espIOTLibChunkPrintf("<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/>");
+    espIOTLibChunkPrintf("<title>%s - Main</title></head><body><div><p>Main page of %s", iotWebConf->getThingName(), iotWebConf->getThingName());
+    espIOTLibChunkPrintf("</p><p>Using Chip: %s", CHIP_IDENT);
 #if defined(ESP32)
-    s += ", Revision: ";
-    s += ESP.getChipRevision();
-    s += ", ";
-    s += ESP.getChipCores();
-    s += " Cores @ ";
-    s += ESP.getCpuFreqMHz();
-    s += " MHz";
+    espIOTLibChunkPrintf(", Revision: %u, %u Cores @ %u MHz", ESP.getChipRevision(), ESP.getChipCores(), ESP.getCpuFreqMHz());
 #endif
-    s += "</p><p>SDK Version: ";
-    s += String(ESP.getSdkVersion());
-    s += "</p></div><hr/>";
+    espIOTLibChunkPrintf("</p><p>SDK Version: %s</p></div><hr/>", ESP.getSdkVersion());
     if(doMqtt){
-        s += "<p>MQTT Config: </p>";
-        s += "<ul>";
-        s += "<li>Server: ";
-        s += mqttServer;
-        s += "</li>";
-        s += "<li>User: ";
-        s += mqttUserName;
-        s += "</li>";
+        espIOTLibChunkPrintf("<p>MQTT Config: </p><ul><li>Server: %s</li><li>User: %s</li>", mqttServer, mqttUserName);
         if(mqttClient.connected()){
-            s += "<li>Connected!</li>";
+            espIOTLibChunkPrintf("<li>Connected!</li>");
         } else {
-            s += "<li>Not Connected</li>";
+            espIOTLibChunkPrintf("<li>Not Connected</li>");
         }
-        s += "</ul>";
-        s += "<p>MQTT Defaults: </p>";
-        s += "<ul>";
-        s += "<li>Server: ";
-        s += mqttDefaultServer;
-        s += "</li>";
-        s += "<li>User: ";
-        s += mqttDefaultUserName;
-        s += "</li>";
-        s += "</ul>";
-        s += "<hr/>";
+        espIOTLibChunkPrintf("</ul><p>MQTT Defaults: </p><ul><li>Server: %s</li><li>User: %s</li></ul><hr/>", mqttDefaultServer, mqttDefaultUserName);
     }
     if(doStaticIP){
-        s += "<p>IP Config: </p>";
-        s += "<ul>";
-        s += "<li>IP address: ";
-        s += ipAddressValue;
-        s += "</li>";
-        s += "<li>Gateway: ";
-        s += gatewayValue;
-        s += "</li>";
-        s += "<li>Netmask: ";
-        s += netmaskValue;
-        s += "</li>";
-        s += "<li>DNS address: ";
-        s += dnsValue;
-        s += "</li>";
-        s += "</ul>";
-        s += "<hr/>";
+        espIOTLibChunkPrintf("<p>IP Config: </p><ul><li>IP address: %s</li><li>Gateway: %s</li>", ipAddressValue, gatewayValue);
+        espIOTLibChunkPrintf("<li>Netmask: %s</li><li>DNS address: %s</li></ul><hr/>", netmaskValue, dnsValue);
     }
     if(doOTAUpdate){
-        s += "<p>OTA update available under: ";
-        s += ip.toString();
-        s += ":";
-        s += String(OTA_PORT);
-        s += "</p>";
-        s += "<hr/>";
+        espIOTLibChunkPrintf("<p>OTA update available under: ");
+        espIOTLibChunkIP(ip);
+        espIOTLibChunkPrintf(":%d</p><hr/>", OTA_PORT);
     }
-    s += "<p>Go to <a href='" ESP_IOTLIB_WEB_ENDPOINT "'>configure page</a> to change values.</p>";
-    s += "<p><a href='" ESP_IOTLIB_STATUS_ENDPOINT "'>Status</a> | <a href='" ESP_IOTLIB_RESET_ENDPOINT "'>Reset CPU</a> | <a href='" ESP_IOTLIB_MQTT_RECONNECT_ENDPOINT "'>Force MQTT Reconnect</a></p>";
-    s += "</body></html>\n";
-
-    localServer->send(200, "text/html", s);
+    espIOTLibChunkPrintf("<p>Go to <a href='" ESP_IOTLIB_WEB_ENDPOINT "'>configure page</a> to change values.</p>");
+    espIOTLibChunkPrintf("<p><a href='" ESP_IOTLIB_STATUS_ENDPOINT "'>Status</a> | <a href='" ESP_IOTLIB_METRICS_ENDPOINT "'>Metrics</a> | <a href='" ESP_IOTLIB_LOG_ENDPOINT "'>Log</a> | <a href='" ESP_IOTLIB_RESET_ENDPOINT "'>Reset CPU</a> | <a href='" ESP_IOTLIB_MQTT_RECONNECT_ENDPOINT "'>Force MQTT Reconnect</a></p>");
+    espIOTLibChunkPrintf("</body></html>\n");
+    espIOTLibChunkEnd();
 }
 
 void handleStatus(){
@@ -320,119 +660,284 @@ void handleStatus(){
         return;
     }
 
-    String s = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/>";
-    s += "<title>";
-    s += iotWebConf->getThingName();
-    s += " - Status</title></head><body><div><p>Status page of ";
-    s += iotWebConf->getThingName();
-    s += "</p>"; 
-    s += "</p><p>Using Chip: "; 
-    s += String(CHIP_IDENT);
-    s += " @ SDK Version: ";
-    s += String(ESP.getSdkVersion());
-    s += "</p>";
-    s += "<hr/>";
-
-    s += "<h3>Free Memory</h3>";
-    s += "<ul>";
-    s += "<li>Heap: ";
-    s += String(ESP.getFreeHeap()/1024.0);
-    s += " kB</li><li>Flash: ";
-    s += String(ESP.getFreeSketchSpace()/1024.0);
-    s += " kB</li>";
+    espIOTLibChunkBegin("text/html");
+    espIOTLibChunkPrintf("<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/>");
+    espIOTLibChunkPrintf("<title>%s - Status</title></head><body><div><p>Status page of %s", iotWebConf->getThingName(), iotWebConf->getThingName());
+    espIOTLibChunkPrintf("</p></p><p>Using Chip: %s @ SDK Version: %s</p><hr/>", CHIP_IDENT, ESP.getSdkVersion());
+
+    espIOTLibChunkPrintf("<h3>Free Memory</h3><ul>");
+    espIOTLibChunkPrintf("<li>Heap: %.2f kB</li><li>Flash: %.2f kB</li>", ESP.getFreeHeap()/1024.0, ESP.getFreeSketchSpace()/1024.0);
 #ifdef ESP8266
-    s += "<li>Stack: ";
-    s += String(ESP.getFreeContStack());
-    s += " Bytes</li>";
+    espIOTLibChunkPrintf("<li>Stack: %u Bytes</li>", ESP.getFreeContStack());
 #elif defined(ESP32)
-    s += "<li>PSRAM: ";
-    s += String(ESP.getFreePsram()/1024.0);
-    s += " kB</li>";
+    espIOTLibChunkPrintf("<li>PSRAM: %.2f kB</li>", ESP.getFreePsram()/1024.0);
 #endif
-    s += "</ul></div><hr/>";
+    espIOTLibChunkPrintf("</ul></div><hr/>");
+
+    espIOTLibChunkPrintf("<h3>Heap History</h3><table><tr><th>Age [min]</th><th>Free [B]</th><th>Min Free [B]</th><th>Largest Block [B]</th></tr>");
+    for(uint8_t i = 0; i < heapHistoryCount; i++){
+        espIOTLibHeapSample *sample = &heapHistory[(heapHistoryNext + ESP_IOTLIB_HEAP_HISTORY - 1 - i) % ESP_IOTLIB_HEAP_HISTORY];
+        espIOTLibChunkPrintf("<tr><td>%lu</td><td>%u</td><td>%u</td><td>%u</td></tr>", (unsigned long)((millis() - sample->time) / 60000), sample->freeHeap, sample->minFreeHeap, sample->largestBlock);
+    }
+    espIOTLibChunkPrintf("</table><p>Smallest largest block since boot: %u B</p><hr/>", heapLargestBlockMin);
+
+    espIOTLibChunkPrintf("<h3>Power</h3><ul><li>Power save: %s</li>", doPowerSave ? "Enabled" : "Disabled");
+    espIOTLibChunkPrintf("<li>Duty cycle: %.2f %%</li></ul><hr/>", dutyCycle);
 
-    s += "<h3>Connection Status</h3><ul>";
-    s += "<li>WiFi: ";
+    espIOTLibChunkPrintf("<h3>Connection Status</h3><ul><li>WiFi: ");
     if(WiFi.isConnected()){
-        s += "Connected</li>";
-        s += "<li>SSID: ";
-        s += WiFi.SSID();
-        s += "</li><li>IP: ";
-        s += WiFi.localIP().toString();
-        s += "</li><li>Mask: ";
-        s += WiFi.subnetMask().toString();
-        s += "</li><li>DNS: ";
-        s += WiFi.dnsIP().toString();
-        s += "</li><li>Broadcast: ";
-        s += WiFi.broadcastIP().toString();
-        s += "</li><li>MAC: ";
-        s += WiFi.macAddress();
-        s += "</li></ul>";
+        espIOTLibChunkPrintf("Connected</li><li>SSID: %s</li><li>IP: ", iotWebConf->getWifiAuthInfo().ssid);
+        espIOTLibChunkIP(WiFi.localIP());
+        espIOTLibChunkPrintf("</li><li>Mask: ");
+        espIOTLibChunkIP(WiFi.subnetMask());
+        espIOTLibChunkPrintf("</li><li>DNS: ");
+        espIOTLibChunkIP(WiFi.dnsIP());
+        espIOTLibChunkPrintf("</li><li>Broadcast: ");
+        espIOTLibChunkIP(WiFi.broadcastIP());
+        espIOTLibChunkPrintf("</li><li>MAC: ");
     } else {
-        s += "Not Connected";
-        s += "</li><li>MAC: ";
-        s += WiFi.macAddress();
-        s += "</li></ul>";
+        espIOTLibChunkPrintf("Not Connected</li><li>MAC: ");
     }
-    s += "<hr/>";
+    espIOTLibChunkMAC();
+    espIOTLibChunkPrintf("</li></ul><hr/>");
 
     if(doMqtt){
-        s += "<h3>MQTT Status</h3><ul>";
-        s += "<li>Server: ";
-        s += mqttServer;
-        s += "</li><li>User: ";
-        s += mqttUserName;
-        s += "</li>";
+        espIOTLibChunkPrintf("<h3>MQTT Status</h3><ul><li>Server: %s</li><li>User: %s</li>", mqttServer, mqttUserName);
         if(mqttClient.connected()){
-            s += "<li>Connected!</li>";
+            espIOTLibChunkPrintf("<li>Connected!</li>");
         } else {
-            s += "<li>Not Connected</li>";
+            espIOTLibChunkPrintf("<li>Not Connected</li>");
         }
-        s += "<li>Return Code: ";
-        s += espIOTLibMQTTReturnToString(mqttClient.returnCode());
-        s += "</li><li>Last Error: ";
-        s += espIOTLibMQTTErrorToString(mqttClient.lastError());
-        s += "</li>";
-        s += "</ul>";
-        s += "<hr/>";
+        espIOTLibChunkPrintf("<li>State: %s, %u failed attempts in a row</li>", espIOTLibMQTTStateToString(), mqttFailures);
+        espIOTLibChunkPrintf("<li>Last connect latency: %u ms</li>", mqttConnectLatency);
+        espIOTLibChunkPrintf("<li>Return Code: %s</li>", espIOTLibMQTTReturnToString(mqttClient.returnCode()));
+        espIOTLibChunkPrintf("<li>Last Error: %s</li></ul><hr/>", espIOTLibMQTTErrorToString(mqttClient.lastError()));
     }
 
-    s += "<p><a href='/'>HOME</a></p>";
-    s += "</body></html>\n";
-    localServer->send(200, "text/html", s);
+    espIOTLibChunkPrintf("<p><a href='/'>HOME</a></p></body></html>\n");
+    espIOTLibChunkEnd();
 }
 
 void handleResetReq(){
-    localServer->send(200, "text/html", "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>Resetting...</title></head><body><div><p>Resetting...</p></div><hr /><p><a href='/'>HOME</a></p></body></html>\n");
+    localServer->send_P(200, "text/html", "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>Resetting...</title></head><body><div><p>Resetting...</p></div><hr /><p><a href='/'>HOME</a></p></body></html>\n");
     delay(500);
     ESP.restart(); // Works for ESP8266 and ESP32
 }
 void handleMQTTReconnReq(){
-    localServer->send(200, "text/html", "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>MQTT Reconnect...</title></head><body><div><p>Trying MQTT Reconnect...</p></div><hr /><p><a href='/'>HOME</a></p></body></html>\n");
-    delay(500);
-    mqttClient.disconnect();
-    espIOTLibMQTTConnect();
+    if(!doMqtt){
+        localServer->send_P(200, "text/html", "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>MQTT disabled</title></head><body><div><p>MQTT is not enabled.</p></div><hr /><p><a href='/'>HOME</a></p></body></html>\n");
+        return;
+    }
+    localServer->send_P(200, "text/html", "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>MQTT Reconnect...</title></head><body><div><p>Trying MQTT Reconnect...</p></div><hr /><p><a href='/'>HOME</a></p></body></html>\n");
+    // Restart the state machine without backoff, the attempt runs from espIOTLibLoop()
+    if(mqttState == MQTT_STATE_CONNECTED){
+        mqttClient.disconnect();
+    } else if(mqttState == MQTT_STATE_RESOLVING || mqttState == MQTT_STATE_CONNECTING){
+        espIOTLibMQTTFailed("restart requested");
+    }
+    mqttFailures = 0;
+    espIOTLibMQTTBackoff();
+}
+
+void espIOTLibChunkBegin(const char *contentType){
+    localServer->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    localServer->send(200, contentType, "");
+    chunkLen = 0;
+}
+
+void espIOTLibChunkFlush(){
+    if(chunkLen){
+        localServer->sendContent(chunkBuffer, chunkLen);
+        chunkLen = 0;
+    }
+}
+
+void espIOTLibChunkEnd(){
+    espIOTLibChunkFlush();
+    localServer->sendContent("", 0);
+}
+
+// Append data of any length to the response, longer than a chunk is sent as it is
+void espIOTLibChunkWrite(const char *data, size_t len){
+    if(chunkLen + len < ESP_IOTLIB_CHUNK_LEN){
+        memcpy(chunkBuffer + chunkLen, data, len);
+        chunkLen += len;
+        return;
+    }
+    espIOTLibChunkFlush();
+    if(len < ESP_IOTLIB_CHUNK_LEN){
+        memcpy(chunkBuffer, data, len);
+        chunkLen = len;
+    } else {
+        localServer->sendContent(data, len);
+    }
+}
+
+// Append to the response chunk, sends the chunk whenever it is full. Use espIOTLibChunkWrite() for long strings
+void espIOTLibChunkPrintf(const char *format, ...){
+    va_list args;
+    for(uint8_t tries = 0; tries < 2; tries++){
+        va_start(args, format);
+        int len = vsnprintf(chunkBuffer + chunkLen, ESP_IOTLIB_CHUNK_LEN - chunkLen, format, args);
+        va_end(args);
+        if(len < 0){
+            return;
+        }
+        if(chunkLen + len < ESP_IOTLIB_CHUNK_LEN){
+            chunkLen += len;
+            return;
+        }
+        espIOTLibChunkFlush();
+    }
+    // Longer than a whole chunk, send it truncated
+    chunkLen = ESP_IOTLIB_CHUNK_LEN - 1;
+    espIOTLibChunkFlush();
+    chunkTruncated++;
+    ESP_IOTLIB_LOGW("Response piece longer than %u bytes truncated\n", ESP_IOTLIB_CHUNK_LEN - 1);
+}
+
+void handleMetrics(){
+    espIOTLibChunkBegin("text/plain; version=0.0.4");
+
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "uptime_seconds", "counter", "Time since boot", millis() / 1000.0);
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "heap_free_bytes", "gauge", "Free heap", ESP.getFreeHeap());
+#ifdef ESP8266
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "heap_largest_block_bytes", "gauge", "Largest free heap block", ESP.getMaxFreeBlockSize());
+#elif defined(ESP32)
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "heap_min_free_bytes", "gauge", "Lowest free heap since boot", ESP.getMinFreeHeap());
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "heap_largest_block_bytes", "gauge", "Largest free heap block", ESP.getMaxAllocHeap());
+#endif
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "heap_largest_block_min_bytes", "gauge", "Smallest sampled largest free heap block since boot", heapLargestBlockMin);
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "loop_time_seconds", "gauge", "Awake time of the last loop pass", loopTime / 1e6);
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "loop_time_max_seconds", "gauge", "Longest loop pass since last scrape", loopTimeMax / 1e6);
+    loopTimeMax = 0;
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "duty_cycle_ratio", "gauge", "Awake time per duty window", dutyCycle / 100.0);
+    if(WiFi.isConnected()){
+        espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "wifi_rssi_dbm", "gauge", "WiFi signal strength", WiFi.RSSI());
+    }
+    if(doMqtt){
+        espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "mqtt_connected", "gauge", "MQTT connection state", mqttClient.connected() ? 1 : 0);
+        espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "mqtt_connect_attempts_total", "counter", "MQTT connection attempts", mqttConnectAttempts);
+        espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "mqtt_connect_failures_total", "counter", "Failed MQTT connection attempts", mqttConnectFailures);
+        espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "mqtt_connect_latency_seconds", "gauge", "TCP connect start until CONNACK of the last connection", mqttConnectLatency / 1000.0);
+        espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "mqtt_publish_total", "counter", "MQTT publish attempts", mqttPublishCount);
+        espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "mqtt_publish_failures_total", "counter", "MQTT publishes that were not sent", mqttPublishFailures);
+        espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "mqtt_pool_exhausted_total", "counter", "MQTT message buffer requests that found the pool empty", mqttMsgPoolExhausted);
+    }
+
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "log_dropped_total", "counter", "Log lines overwritten before reaching Serial", logDropped);
+    espIOTLibMetric(ESP_IOTLIB_METRICS_PREFIX "http_chunk_truncated_total", "counter", "Streamed response pieces cut to the chunk size", chunkTruncated);
+
+    if(metricsCB){
+        metricsCB();
+    }
+    espIOTLibChunkEnd();
+}
+
+// Copy from a slot like a seqlock reader: the copy only counts if seq did not change meanwhile
+bool espIOTLibLogCopy(espIOTLibLogSlot *slot, uint32_t seq, size_t offset, size_t max, char *dst, size_t *len){
+    size_t slotLen = slot->len;
+    if(slotLen > ESP_IOTLIB_LOG_LINE_LEN || offset > slotLen){
+        return false;
+    }
+    *len = slotLen - offset < max ? slotLen - offset : max;
+    memcpy(dst, slot->text + offset, *len);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
+// Drain the log ring to Serial without ever blocking on it
+void espIOTLibLogDrain(){
+    char line[ESP_IOTLIB_LOG_LINE_LEN];
+    int space = Serial.availableForWrite();
+    while(space > 0 && logSerialSeq != logHead.load(std::memory_order_acquire)){
+        espIOTLibLogSlot *slot = &logSlots[logSerialSeq % ESP_IOTLIB_LOG_SLOTS];
+        uint32_t seq = slot->seq.load(std::memory_order_acquire);
+        size_t len = 0;
+        if(seq == logSerialSeq && !espIOTLibLogCopy(slot, seq, logSerialOffset, space, line, &len)){
+            // A writer wrapped onto the slot during the copy
+            seq = slot->seq.load(std::memory_order_acquire);
+            if(seq == logSerialSeq){
+                return; // Try again on the next pass
+            }
+        }
+        if(seq != logSerialSeq){
+            if((int32_t)(seq - logSerialSeq) < 0){
+                // Reserved but not yet written
+                return;
+            }
+            // Overwritten before we got to it, skip ahead to the oldest line left
+            uint32_t oldest = logHead.load(std::memory_order_acquire) - ESP_IOTLIB_LOG_SLOTS;
+            if((int32_t)(oldest - logSerialSeq) <= 0){
+                oldest = logSerialSeq + 1;
+            }
+            if(logSerialOffset){
+                // End the part of the line that was already sent
+                Serial.write((const uint8_t*)"\n", 1);
+                space--;
+            }
+            logDropped += oldest - logSerialSeq;
+            logSerialSeq = oldest;
+            logSerialOffset = 0;
+            continue;
+        }
+        Serial.write((const uint8_t*)line, len);
+        space -= len;
+        logSerialOffset += len;
+        if(logSerialOffset >= slot->len){
+            logSerialSeq++;
+            logSerialOffset = 0;
+        }
+    }
+}
+
+void handleLog(){
+    if(localServer->hasArg("level")){
+        espIOTLibSetLogLevel(localServer->arg("level").toInt());
+    }
+    espIOTLibChunkBegin("text/plain");
+    espIOTLibChunkPrintf("# level %u, dropped %u\n", espIOTLibLogLevel, logDropped);
+    uint32_t head = logHead.load(std::memory_order_acquire);
+    uint32_t seq = head > ESP_IOTLIB_LOG_SLOTS ? head - ESP_IOTLIB_LOG_SLOTS : 1;
+    for(; seq != head; seq++){
+        espIOTLibLogSlot *slot = &logSlots[seq % ESP_IOTLIB_LOG_SLOTS];
+        char line[ESP_IOTLIB_LOG_LINE_LEN];
+        size_t len;
+        // Lines overwritten while being copied are left out
+        if(slot->seq.load(std::memory_order_acquire) == seq && espIOTLibLogCopy(slot, seq, 0, sizeof(line), line, &len)){
+            espIOTLibChunkPrintf("%.*s", (int)len, line);
+        }
+    }
+    espIOTLibChunkEnd();
 }
 
 
 // --- Public Vars ---
+volatile uint8_t espIOTLibLogLevel = ESP_IOTLIB_LOG_DEFAULT_LEVEL;
 
 // --- Public Functions ---
 void espIOTLibInit(const char *deviceName, const char *version){
+#ifdef ESP_IOTLIB_STATIC_ALLOC
+    localServer = new (localServerStorage) WebServer(80);
+#else
     localServer = new WebServer(80);
+#endif
     if(!localServer || !deviceName || !version){
         IOT_LOGF("LibInit: Invalid parameters!\n");
         return;
     }
     IOT_LOGF("Initializing espIOTLib for %s at %s (Chip: %s)!\n", deviceName, version, CHIP_IDENT);
-    IOT_LOGF("Free MEM %u, FLASH %u", ESP.getFreeHeap(), ESP.getFreeSketchSpace());
 #ifdef ESP8266
-    IOT_LOGF(", STACK %u\n", ESP.getFreeContStack());
+    IOT_LOGF("Free MEM %u, FLASH %u, STACK %u\n", ESP.getFreeHeap(), ESP.getFreeSketchSpace(), ESP.getFreeContStack());
 #elif defined(ESP32)
-    IOT_LOGF(", PSRAM %u\n", ESP.getFreePsram());
-    IOT_LOGF("Chip Revision: %hhu, Cores: %hhu", ESP.getChipRevision(), ESP.getChipCores());
+    IOT_LOGF("Free MEM %u, FLASH %u, PSRAM %u\n", ESP.getFreeHeap(), ESP.getFreeSketchSpace(), ESP.getFreePsram());
+    IOT_LOGF("Chip Revision: %hhu, Cores: %hhu\n", ESP.getChipRevision(), ESP.getChipCores());
 #endif
+#ifdef ESP_IOTLIB_STATIC_ALLOC
+    iotWebConf = new (iotWebConfStorage) IotWebConf(deviceName, &dnsServer, localServer, ESP_IOTLIB_AP_DEFAULT_PWD, version);
+#else
     iotWebConf = new IotWebConf(deviceName, &dnsServer, localServer, ESP_IOTLIB_AP_DEFAULT_PWD, version);
+#endif
     iotWebConf->setApTimeoutMs(30000);
     iotWebConf->setupUpdateServer(
         [](const char* updatePath) { httpUpdater.setup(localServer, updatePath); },
@@ -442,9 +947,9 @@ void espIOTLibInit(const char *deviceName, const char *version){
     localServer->on(ESP_IOTLIB_WEB_ENDPOINT, []{ iotWebConf->handleConfig(); });
     localServer->on(ESP_IOTLIB_RESET_ENDPOINT, handleResetReq);
     localServer->on(ESP_IOTLIB_STATUS_ENDPOINT, handleStatus);
-    if(doMqtt){
-        localServer->on(ESP_IOTLIB_MQTT_RECONNECT_ENDPOINT, handleMQTTReconnReq);
-    }
+    localServer->on(ESP_IOTLIB_METRICS_ENDPOINT, handleMetrics);
+    localServer->on(ESP_IOTLIB_LOG_ENDPOINT, handleLog);
+    localServer->on(ESP_IOTLIB_MQTT_RECONNECT_ENDPOINT, handleMQTTReconnReq);
     localServer->onNotFound([](){ iotWebConf->handleNotFound(); });
     iotWebConf->setWifiConnectionCallback(&espIOTLibWifiConnectCB);
 
@@ -470,10 +975,10 @@ void espIOTLibStart(){
         }
         
         if(doStaticIP){
-            strncpy(ipAddressValue, ip.toString().c_str(), IP_ADDRESS_BUFFER_LEN);
-            strncpy(gatewayValue, gateway.toString().c_str(), IP_ADDRESS_BUFFER_LEN);
-            strncpy(netmaskValue, mask.toString().c_str(), IP_ADDRESS_BUFFER_LEN);
-            strncpy(dnsValue, dns.toString().c_str(), IP_ADDRESS_BUFFER_LEN);
+            espIOTLibIPToStr(ip, ipAddressValue);
+            espIOTLibIPToStr(gateway, gatewayValue);
+            espIOTLibIPToStr(mask, netmaskValue);
+            espIOTLibIPToStr(dns, dnsValue);
         }
 
     }
@@ -487,7 +992,7 @@ void espIOTLibStaticIP(IPAddress default_ip, IPAddress default_gateway, IPAddres
 
     doStaticIP = true;
     // TODO: Initalize strings?
-    IOT_LOGF("Enabled Static IP, default: %s\n", default_ip.toString().c_str());
+    IOT_LOGF("Enabled Static IP, default: %u.%u.%u.%u\n", default_ip[0], default_ip[1], default_ip[2], default_ip[3]);
 
     connGroup.addItem(&ipAddressParam);
     connGroup.addItem(&gatewayParam);
@@ -501,15 +1006,22 @@ void espIOTLibStaticIP(IPAddress default_ip, IPAddress default_gateway, IPAddres
 void espIOTLibLoop(){
     if(iotWebConf)
         iotWebConf->doLoop();
+    if(localServer && localServer->client().connected()){
+        lastActivity = millis();
+    }
     if(doMqtt){
-        espIOTLibReconnectMQTT();
-        if (mqttClient.connected()){
+        espIOTLibMQTTStep();
+        if (mqttState == MQTT_STATE_CONNECTED){
             mqttClient.loop();
         }
     }
     if(doOTAUpdate){
         ArduinoOTA.handle();
     }
+    if(heapHistoryCount == 0 || millis() - heapLastSample >= ESP_IOTLIB_HEAP_SAMPLE_MS){
+        espIOTLibHeapSampleNow();
+    }
+    espIOTLibLogDrain();
 }
 
 bool espIOTLibConnectedToWifi(){
@@ -528,7 +1040,7 @@ const char *espIOTLibGetSSID(){
 }
 
 void espIOTLibAddCB(espIOTLibCB callback){
-    IOT_LOGF("Added wifi connection CB at %p\n", callback);
+    IOT_LOGF("Added wifi connection CB at %p\n", (void*)callback);
     wifiConnectCB = callback;
 }
 
@@ -557,42 +1069,71 @@ void espIOTLibEnableMQTT(const char *server, const char *username, const char *p
     iotWebConf->addParameterGroup(&mqttGroup);
 }
 void espIOTLibAddMQTTCB(espIOTLibMQTTCB mqttCB){
-    MQTT_LOGF("Adding MQTT subscribe CB at %p\n", mqttCB);
+    MQTT_LOGF("Adding MQTT subscribe CB at %p\n", (void*)mqttCB);
     if(mqttCB && doMqtt)
         mqttClient.onMessageAdvanced(mqttCB);
 }
+// Subscribe now (if connected) and after every reconnect, topic must stay valid
 void espIOTLibSubscribeMQTT(const char* topic){
     if(topic && doMqtt){
         MQTT_LOGF("Subscribing to %s\n", topic);
-        mqttClient.subscribe(topic);
+        if(mqttSubscriptionCount < ESP_IOTLIB_MQTT_MAX_SUBSCRIPTIONS){
+            mqttSubscriptions[mqttSubscriptionCount++] = topic;
+        } else {
+            ESP_IOTLIB_LOGW(LOG_MQTT_IDENT "Too many subscriptions, %s not kept\n", topic);
+        }
+        if(mqttClient.connected()){
+            mqttClient.subscribe(topic);
+        }
+    }
+}
+// Take a message buffer (ESP_IOTLIB_MQTT_BUFFER_SIZE bytes) from the pool, NULL if all are in use
+char *espIOTLibMQTTMsgAcquire(){
+    for(uint8_t i = 0; i < ESP_IOTLIB_MQTT_POOL_SLOTS; i++){
+        bool expected = false;
+        if(mqttMsgPoolUsed[i].compare_exchange_strong(expected, true)){
+            return mqttMsgPool[i];
+        }
+    }
+    mqttMsgPoolExhausted++;
+    return NULL;
+}
+void espIOTLibMQTTMsgRelease(char *msg){
+    for(uint8_t i = 0; i < ESP_IOTLIB_MQTT_POOL_SLOTS; i++){
+        if(msg == mqttMsgPool[i]){
+            mqttMsgPoolUsed[i].store(false);
+            return;
+        }
     }
 }
+void espIOTLibEnableHeapReport(const char *topic){
+    MQTT_LOGF("Heap report to %s\n", topic);
+    heapReportTopic = topic;
+}
 // Publish int value to MQTT
 void espIOTLibPublishInt(const char *topic, uint32_t value){
     if(!doMqtt)
         return;
     // Turn int into string
     snprintf(mqttDataBuffer, ESP_IOTLIB_MQTT_DATA_BUFFER_LEN-1, "%d", value);
-    MQTT_LOGF("MQTT pub: %s Int: %s", topic, mqttDataBuffer);
-    // Publish if connected
-    if (connectedToWifi && mqttClient.connected()){
-        MQTT_LOGF(" OK\n");
-        mqttClient.publish(topic, mqttDataBuffer);
-    } else {
-        MQTT_LOGF(" No Connection...\n");
-    }
+    espIOTLibMQTTPublish(topic, mqttDataBuffer);
 }
 // Publish str value to MQTT (value _must_ be null terminated)
 void espIOTLibPublishStr(const char *topic, char *value){
     if(!doMqtt)
         return;
-    MQTT_LOGF("MQTT pub: %s STR: %s", topic, value);
-    // Publish if connected
-    if (connectedToWifi && mqttClient.connected()){
-        MQTT_LOGF(" OK\n");
-        mqttClient.publish(topic, value);
+    espIOTLibMQTTPublish(topic, value);
+}
+// Publish a binary payload of len bytes to MQTT
+void espIOTLibPublishBin(const char *topic, const uint8_t *payload, uint16_t len){
+    if(!doMqtt)
+        return;
+    mqttPublishCount++;
+    if (connectedToWifi && mqttClient.connected() && mqttClient.publish(topic, (const char *)payload, len)){
+        MQTT_LOGF("MQTT pub: %s: %u bytes OK\n", topic, len);
     } else {
-        MQTT_LOGF(" No Connection...\n");
+        MQTT_LOGF("MQTT pub: %s: %u bytes Failed!\n", topic, len);
+        mqttPublishFailures++;
     }
 }
 // Publish float value to MQTT
@@ -605,14 +1146,7 @@ void espIOTLibPublishFloat(const char *topic, double value){
     }
     // Turn float into string
     dtostrf( value, ESP_IOTLIB_MQTT_DATA_BUFFER_LEN-1, mqttFloatPrecision, mqttDataBuffer);
-    MQTT_LOGF("MQTT pub: %s Float: %s", topic, mqttDataBuffer);
-    // Publish if connected
-    if (connectedToWifi && mqttClient.connected()){
-        MQTT_LOGF(" OK\n");
-        mqttClient.publish(topic, mqttDataBuffer);
-    } else {
-        MQTT_LOGF(" No Connection...\n");
-    }
+    espIOTLibMQTTPublish(topic, mqttDataBuffer);
 }
 
     // OTA
@@ -625,4 +1159,138 @@ void espIOTLibEnableOTA(const char *md5Password){
     ArduinoOTA.setPasswordHash(md5Password);
     doOTAUpdate = true;
     IOT_LOGF("Enabling OTA at port %d\n", OTA_PORT);
-}
\ No newline at end of file
+}
+
+    // Metrics
+void espIOTLibAddMetricsCB(espIOTLibMetricsCB callback){
+    IOT_LOGF("Added metrics CB at %p\n", (void*)callback);
+    metricsCB = callback;
+}
+void espIOTLibMetricHeader(const char *name, const char *type, const char *help){
+    espIOTLibChunkPrintf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+void espIOTLibMetricValue(const char *name, const char *labels, double value){
+    const char *labelOpen = labels ? "{" : "";
+    const char *labelClose = labels ? "}" : "";
+    if(!labels)
+        labels = "";
+    if(isnan(value)){
+        espIOTLibChunkPrintf("%s%s%s%s NaN\n", name, labelOpen, labels, labelClose);
+    } else {
+        espIOTLibChunkPrintf("%s%s%s%s %.9g\n", name, labelOpen, labels, labelClose, value);
+    }
+}
+void espIOTLibMetric(const char *name, const char *type, const char *help, double value){
+    espIOTLibMetricHeader(name, type, help);
+    espIOTLibMetricValue(name, NULL, value);
+}
+
+    // Log
+// Format into the next ring slot; safe from any task, Serial is only touched by the drain in espIOTLibLoop()
+void espIOTLibLogf(uint8_t level, const char *format, ...){
+    uint32_t seq = logHead.fetch_add(1, std::memory_order_relaxed);
+    espIOTLibLogSlot *slot = &logSlots[seq % ESP_IOTLIB_LOG_SLOTS];
+    // Mark the slot as being written, readers check seq again after copying the text
+    slot->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int len = snprintf(slot->text, ESP_IOTLIB_LOG_LINE_LEN, "%lu %c ", (unsigned long)millis(), logLevelChars[level < sizeof(logLevelChars) - 1 ? level : 0]);
+    va_list args;
+    va_start(args, format);
+    int msgLen = vsnprintf(slot->text + len, ESP_IOTLIB_LOG_LINE_LEN - len, format, args);
+    va_end(args);
+    if(msgLen < 0){
+        msgLen = 0;
+    }
+    len += msgLen;
+    if(len >= ESP_IOTLIB_LOG_LINE_LEN){
+        // Truncated, keep the line ending
+        len = ESP_IOTLIB_LOG_LINE_LEN - 1;
+        slot->text[len - 1] = '\n';
+    }
+    slot->len = len;
+    slot->seq.store(seq, std::memory_order_release);
+}
+
+void espIOTLibSetLogLevel(uint8_t level){
+    if(level > ESP_IOTLIB_LOG_DEBUG)
+        level = ESP_IOTLIB_LOG_DEBUG;
+    espIOTLibLogLevel = level;
+}
+
+    // Power
+void espIOTLibEnablePowerSave(){
+    doPowerSave = true;
+    IOT_LOGF("Enabling power save\n");
+    if(connectedToWifi){
+        espIOTLibApplyPowerSave();
+    }
+}
+
+// End the current idle slice early, safe to call from other tasks
+void espIOTLibWake(){
+#if defined(ESP32)
+    if(idleTask)
+        xTaskNotifyGive(idleTask);
+#endif
+}
+// Sleep until deadline (millis) or until something needs the CPU earlier
+void espIOTLibIdleUntil(uint32_t deadline){
+    uint32_t now = millis();
+    uint32_t cap = ESP_IOTLIB_IDLE_MAX_MS;
+    // Keep the config portal and active web clients responsive
+    if(!iotWebConf || iotWebConf->getState() != iotwebconf::OnLine || now - lastActivity < ESP_IOTLIB_WEB_ACTIVE_MS){
+        cap = ESP_IOTLIB_IDLE_PORTAL_MS;
+    }
+    int32_t wait = (int32_t)(deadline - now);
+    if(wait > (int32_t)cap){
+        wait = cap;
+    }
+
+    uint32_t sleepStart = micros();
+    // setup() is not a loop pass
+    if(!idleStarted){
+        idleStarted = true;
+        loopWakeTime = sleepStart;
+        dutyWindowStart = sleepStart;
+    }
+    loopTime = sleepStart - loopWakeTime;
+    if(loopTime > loopTimeMax){
+        loopTimeMax = loopTime;
+    }
+    if(wait > 0){
+#if defined(ESP32)
+        if(!idleTask){
+            idleTask = xTaskGetCurrentTaskHandle();
+            WiFi.onEvent(espIOTLibWifiEventCB);
+        }
+        // Blocks the loop task, the idle task (and the PM driver) take over
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+#else
+        delay(wait);
+#endif
+    }
+    uint32_t sleepEnd = micros();
+    dutyIdleTime += sleepEnd - sleepStart;
+    loopWakeTime = sleepEnd;
+
+    // Duty cycle over the last window
+    uint32_t window = sleepEnd - dutyWindowStart;
+    if(window >= ESP_IOTLIB_DUTY_WINDOW_MS * 1000UL){
+        if(dutyIdleTime > window){
+            dutyIdleTime = window;
+        }
+        dutyCycle = 100.0 * (window - dutyIdleTime) / window;
+        dutyWindowStart = sleepEnd;
+        dutyIdleTime = 0;
+    }
+}
+
+// Keep idle slices short for a while, e.g. after serving a network request
+void espIOTLibMarkActivity(){
+    lastActivity = millis();
+}
+
+float espIOTLibGetDutyCycle(){
+    return dutyCycle;
+}
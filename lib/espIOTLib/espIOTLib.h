@@ -34,25 +34,116 @@
 #ifndef ESP_IOTLIB_MQTT_PORT
     #define ESP_IOTLIB_MQTT_PORT 1883
 #endif
+#ifndef ESP_IOTLIB_MQTT_MAX_SUBSCRIPTIONS
+    #define ESP_IOTLIB_MQTT_MAX_SUBSCRIPTIONS 4
+#endif
+// Message buffers for espIOTLibMQTTMsgAcquire()
+#ifndef ESP_IOTLIB_MQTT_POOL_SLOTS
+    #define ESP_IOTLIB_MQTT_POOL_SLOTS 2
+#endif
+// Reconnect backoff: starts at the interval, doubles per failed attempt up to the max
 #ifndef ESP_IOTLIB_MQTT_RECONNECT_INTERVAL
     #define ESP_IOTLIB_MQTT_RECONNECT_INTERVAL 5000
 #endif
+#ifndef ESP_IOTLIB_MQTT_RECONNECT_MAX_INTERVAL
+    #define ESP_IOTLIB_MQTT_RECONNECT_MAX_INTERVAL 120000
+#endif
+// Give up on a TCP connect that has not completed after this
+#ifndef ESP_IOTLIB_MQTT_CONNECT_TIMEOUT
+    #define ESP_IOTLIB_MQTT_CONNECT_TIMEOUT 5000
+#endif
+// Longest wait for CONNACK (and any other MQTT command) once TCP is up. The connect is only partly
+// non-blocking: on ESP32 the DNS lookup and TCP connect run in the background, but the loop blocks
+// for up to this long waiting for CONNACK. On ESP8266 the whole connect blocks.
+#ifndef ESP_IOTLIB_MQTT_CONNACK_TIMEOUT
+    #define ESP_IOTLIB_MQTT_CONNACK_TIMEOUT 500
+#endif
+
+// Longest idle slice while connected as station (bounds web / MQTT / OTA latency)
+#ifndef ESP_IOTLIB_IDLE_MAX_MS
+    #define ESP_IOTLIB_IDLE_MAX_MS 100
+#endif
+// Idle slice while the config portal is up or a client was recently active
+#ifndef ESP_IOTLIB_IDLE_PORTAL_MS
+    #define ESP_IOTLIB_IDLE_PORTAL_MS 5
+#endif
+#ifndef ESP_IOTLIB_WEB_ACTIVE_MS
+    #define ESP_IOTLIB_WEB_ACTIVE_MS 2000
+#endif
+// Chunk size for streamed responses (/metrics, /log)
+#ifndef ESP_IOTLIB_CHUNK_LEN
+    #define ESP_IOTLIB_CHUNK_LEN 512
+#endif
+#ifndef ESP_IOTLIB_METRICS_PREFIX
+    #define ESP_IOTLIB_METRICS_PREFIX "esp_"
+#endif
+// Heap sampling (free / min free / largest block)
+#ifndef ESP_IOTLIB_HEAP_SAMPLE_MS
+    #define ESP_IOTLIB_HEAP_SAMPLE_MS 60000
+#endif
+#ifndef ESP_IOTLIB_HEAP_HISTORY
+    #define ESP_IOTLIB_HEAP_HISTORY 24
+#endif
+// Define to place WebServer and IotWebConf in static storage instead of the heap
+//#define ESP_IOTLIB_STATIC_ALLOC
+// Window over which the duty cycle (awake time / total time) is measured
+#ifndef ESP_IOTLIB_DUTY_WINDOW_MS
+    #define ESP_IOTLIB_DUTY_WINDOW_MS 10000
+#endif
+
+// Log levels
+#define ESP_IOTLIB_LOG_NONE 0
+#define ESP_IOTLIB_LOG_ERROR 1
+#define ESP_IOTLIB_LOG_WARN 2
+#define ESP_IOTLIB_LOG_INFO 3
+#define ESP_IOTLIB_LOG_DEBUG 4
+
+// Log ring buffer: slots of one line each
+#ifndef ESP_IOTLIB_LOG_SLOTS
+    #define ESP_IOTLIB_LOG_SLOTS 32
+#endif
+#ifndef ESP_IOTLIB_LOG_LINE_LEN
+    #define ESP_IOTLIB_LOG_LINE_LEN 160
+#endif
+// Levels above this are compiled out
+#ifndef ESP_IOTLIB_LOG_MAX_LEVEL
+    #define ESP_IOTLIB_LOG_MAX_LEVEL ESP_IOTLIB_LOG_DEBUG
+#endif
 
-//Use these for debug logging
+//Use these for debug logging (sets the default runtime level to debug)
 //#define ESP_IOTLIB_MQTT_LOG
 //#define ESP_IOTLIB_IOT_LOG
 
+#ifndef ESP_IOTLIB_LOG_DEFAULT_LEVEL
+    #if defined(ESP_IOTLIB_MQTT_LOG) || defined(ESP_IOTLIB_IOT_LOG)
+        #define ESP_IOTLIB_LOG_DEFAULT_LEVEL ESP_IOTLIB_LOG_DEBUG
+    #else
+        #define ESP_IOTLIB_LOG_DEFAULT_LEVEL ESP_IOTLIB_LOG_INFO
+    #endif
+#endif
+
 #ifndef ESP_IOTLIB_IOT_LOG
     #define IOTWEBCONF_DEBUG_DISABLED
 #endif
 
 // --- Marcos ---
+// Arguments are only evaluated if the level is enabled
+#define ESP_IOTLIB_LOGF(level, ...) do { \
+        if((level) <= ESP_IOTLIB_LOG_MAX_LEVEL && (level) <= espIOTLibLogLevel) \
+            espIOTLibLogf((level), __VA_ARGS__); \
+    } while(0)
+#define ESP_IOTLIB_LOGE(...) ESP_IOTLIB_LOGF(ESP_IOTLIB_LOG_ERROR, __VA_ARGS__)
+#define ESP_IOTLIB_LOGW(...) ESP_IOTLIB_LOGF(ESP_IOTLIB_LOG_WARN, __VA_ARGS__)
+#define ESP_IOTLIB_LOGI(...) ESP_IOTLIB_LOGF(ESP_IOTLIB_LOG_INFO, __VA_ARGS__)
+#define ESP_IOTLIB_LOGD(...) ESP_IOTLIB_LOGF(ESP_IOTLIB_LOG_DEBUG, __VA_ARGS__)
 
 // --- Typedefs ---
 typedef void (*espIOTLibCB)(void);
 typedef void (*espIOTLibMQTTCB)(MQTTClient *client, char topic[], char bytes[], int length);
+typedef void (*espIOTLibMetricsCB)(void);
 
 // --- Public Vars ---
+extern volatile uint8_t espIOTLibLogLevel;
 
 // --- Public Functions ---
 void espIOTLibInit(const char *deviceName, const char *version);
@@ -67,17 +158,43 @@ IotWebConf *espIOTLibGetIotWebConf();
 const char *espIOTLibGetSSID();
 void espIOTLibAddCB(espIOTLibCB callback);
 void espIOTLibForceConfigPin(int pin);
+    // Streamed (chunked) responses from a static buffer, use instead of building a String
+void espIOTLibChunkBegin(const char *contentType);
+void espIOTLibChunkPrintf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void espIOTLibChunkWrite(const char *data, size_t len);
+void espIOTLibChunkEnd();
 
     // MQTT
 void espIOTLibEnableMQTT(const char *server, const char *username, const char *password);
 MQTTClient *espIOTLibGetMQTTClient();
 void espIOTLibAddMQTTCB(espIOTLibMQTTCB mqttCB);
 void espIOTLibSubscribeMQTT(const char* topic);
+char *espIOTLibMQTTMsgAcquire();
+void espIOTLibMQTTMsgRelease(char *msg);
+void espIOTLibEnableHeapReport(const char *topic);
 void espIOTLibPublishInt(const char *topic, uint32_t value);
 void espIOTLibPublishStr(const char *topic, char *value);
+void espIOTLibPublishBin(const char *topic, const uint8_t *payload, uint16_t len);
 void espIOTLibPublishFloat(const char *topic, double value);
 
     // OTA
 void espIOTLibEnableOTA(const char *md5Password);
 
+    // Metrics (Prometheus text format, only valid inside a metrics CB)
+void espIOTLibAddMetricsCB(espIOTLibMetricsCB metricsCB);
+void espIOTLibMetricHeader(const char *name, const char *type, const char *help);
+void espIOTLibMetricValue(const char *name, const char *labels, double value);
+void espIOTLibMetric(const char *name, const char *type, const char *help, double value);
+
+    // Log
+void espIOTLibLogf(uint8_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void espIOTLibSetLogLevel(uint8_t level);
+
+    // Power
+void espIOTLibEnablePowerSave();
+void espIOTLibIdleUntil(uint32_t deadline);
+void espIOTLibWake();
+void espIOTLibMarkActivity();
+float espIOTLibGetDutyCycle();
+
 #endif /* ESPIOTLIB_H */
\ No newline at end of file
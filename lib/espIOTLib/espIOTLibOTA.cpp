@@ -0,0 +1,368 @@
+/**
+ * @file espIOTLibOTA.cpp
+ * @author agent (agent@local)
+ * @brief Resumable OTA updates from compressed, individually checked blocks
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include "espIOTLibOTA.h"
+#include "espIOTLib.h"
+
+#if defined(ESP32)
+#  include <Preferences.h>
+#  include <esp_ota_ops.h>
+#  include <esp_partition.h>
+#endif
+
+// --- Defines ---
+#define OTA_ADMIN_USER "admin"
+#define OTA_PREFS_NAMESPACE "espiotota"
+#define OTA_STATUS_LEN 256
+
+#define OTA_BLOCK_NONE 0
+#define OTA_BLOCK_RECEIVING 1
+#define OTA_BLOCK_DUPLICATE 2
+#define OTA_BLOCK_REJECTED 3
+
+// --- Marcos ---
+#define OTA_BLOCKS(size) (((size) + ESP_IOTLIB_OTA_BLOCK_SIZE - 1) / ESP_IOTLIB_OTA_BLOCK_SIZE)
+
+// --- Typedefs ---
+
+// --- Private Vars ---
+static const uint32_t crcTable[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+#if defined(ESP32)
+static WebServer *server = NULL;
+static Preferences prefs;
+static const esp_partition_t *partition = NULL;
+    // Upload, kept in NVS
+static bool active = false;
+static uint32_t imageSize = 0;
+static uint32_t imageCrc = 0;
+static uint32_t nextBlock = 0;
+static uint32_t lastBlockCrc = 0;
+    // Block being received
+static uint8_t block[ESP_IOTLIB_OTA_BLOCK_SIZE];
+static espIOTLibOTADecoder decoder;
+static uint8_t blockState = OTA_BLOCK_NONE;
+static const char *blockError = "";
+static uint32_t blockIndex = 0;
+static uint32_t blockCrc = 0;
+static bool blockRaw = false;
+static uint16_t blockRawLen = 0;
+#endif
+
+// --- Private Functions ---
+#if defined(ESP32)
+uint16_t espIOTLibOTABlockLen(uint32_t index){
+    uint32_t left = imageSize - index * ESP_IOTLIB_OTA_BLOCK_SIZE;
+    return left < ESP_IOTLIB_OTA_BLOCK_SIZE ? left : ESP_IOTLIB_OTA_BLOCK_SIZE;
+}
+
+uint32_t espIOTLibOTAArg(const char *name){
+    return strtoul(server->arg(name).c_str(), NULL, 0);
+}
+
+bool espIOTLibOTAAuthenticate(){
+    return server->authenticate(OTA_ADMIN_USER, espIOTLibGetIotWebConf()->getApPasswordParameter()->valueBuffer);
+}
+
+void espIOTLibOTASave(){
+    prefs.putUInt("part", partition->address);
+    prefs.putUInt("size", imageSize);
+    prefs.putUInt("crc", imageCrc);
+    prefs.putUInt("next", nextBlock);
+    prefs.putUInt("last", lastBlockCrc);
+}
+
+void espIOTLibOTAClear(){
+    active = false;
+    imageSize = 0;
+    imageCrc = 0;
+    nextBlock = 0;
+    lastBlockCrc = 0;
+    prefs.clear();
+}
+
+// The newest block may have been cut short by a reset after NVS was written, check it against its CRC once after boot
+void espIOTLibOTAVerifyResume(){
+    if(!nextBlock){
+        return;
+    }
+    uint32_t index = nextBlock - 1;
+    uint16_t len = espIOTLibOTABlockLen(index);
+    if(esp_partition_read(partition, index * ESP_IOTLIB_OTA_BLOCK_SIZE, block, len) != ESP_OK || espIOTLibOTACrc32(0, block, len) != lastBlockCrc){
+        ESP_IOTLIB_LOGW("OTA block %u does not match, resending it\n", index);
+        nextBlock = index;
+        // The block before was complete when this one was started
+        lastBlockCrc = 0;
+        if(index){
+            len = espIOTLibOTABlockLen(index - 1);
+            esp_partition_read(partition, (index - 1) * ESP_IOTLIB_OTA_BLOCK_SIZE, block, len);
+            lastBlockCrc = espIOTLibOTACrc32(0, block, len);
+        }
+        espIOTLibOTASave();
+    }
+}
+
+void espIOTLibOTAStatus(int code, const char *error){
+    char json[OTA_STATUS_LEN];
+    const char *state = !active ? "idle" : (nextBlock < OTA_BLOCKS(imageSize) ? "receiving" : "complete");
+    int len = snprintf(json, sizeof(json), "{\"state\": \"%s\",\"size\": %u,\"crc\": %u,\"blocks\": %u,\"next\": %u,\"blockSize\": %u,\"window\": %u,\"lookahead\": %u",
+        state, imageSize, imageCrc, OTA_BLOCKS(imageSize), nextBlock, ESP_IOTLIB_OTA_BLOCK_SIZE, ESP_IOTLIB_OTA_WINDOW_BITS, ESP_IOTLIB_OTA_LOOKAHEAD_BITS);
+    if(error){
+        len += snprintf(json + len, sizeof(json) - len, ",\"error\": \"%s\"", error);
+    }
+    snprintf(json + len, sizeof(json) - len, "}");
+    server->send(code, "application/json", json);
+}
+
+void handleOTAStatus(){
+    if(!espIOTLibOTAAuthenticate()){
+        return server->requestAuthentication();
+    }
+    espIOTLibOTAStatus(200, NULL);
+}
+
+// Same size and CRC as the stored upload continues it, anything else starts over
+void handleOTABegin(){
+    if(!espIOTLibOTAAuthenticate()){
+        return server->requestAuthentication();
+    }
+    uint32_t size = espIOTLibOTAArg("size");
+    uint32_t crc = espIOTLibOTAArg("crc");
+    partition = esp_ota_get_next_update_partition(NULL);
+    if(!partition || size == 0 || size > partition->size){
+        return espIOTLibOTAStatus(400, "invalid size");
+    }
+    if(active && size == imageSize && crc == imageCrc){
+        ESP_IOTLIB_LOGI("OTA resumed at block %u of %u\n", nextBlock, OTA_BLOCKS(imageSize));
+    } else {
+        active = true;
+        imageSize = size;
+        imageCrc = crc;
+        nextBlock = 0;
+        lastBlockCrc = 0;
+        espIOTLibOTASave();
+        ESP_IOTLIB_LOGI("OTA of %u bytes to %s started\n", size, partition->label);
+    }
+    espIOTLibOTAStatus(200, NULL);
+}
+
+// Body of /ota/block, arrives in pieces of HTTP_RAW_BUFLEN
+void handleOTABlockBody(){
+    HTTPRaw &raw = server->raw();
+    if(raw.status == RAW_START){
+        // Without credentials the body is ignored, handleOTABlock() asks for them
+        if(!espIOTLibOTAAuthenticate()){
+            blockState = OTA_BLOCK_NONE;
+            return;
+        }
+        blockState = OTA_BLOCK_REJECTED;
+        blockIndex = espIOTLibOTAArg("index");
+        blockCrc = espIOTLibOTAArg("crc");
+        blockRaw = (server->arg("raw") == "1");
+        blockRawLen = 0;
+        if(!active){
+            blockError = "no upload";
+        } else if(blockIndex < nextBlock){
+            // Answer to a lost response, the block is already written
+            blockState = OTA_BLOCK_DUPLICATE;
+        } else if(blockIndex > nextBlock || blockIndex >= OTA_BLOCKS(imageSize)){
+            blockError = "unexpected block";
+        } else {
+            espIOTLibOTADecoderInit(&decoder, block, espIOTLibOTABlockLen(blockIndex));
+            blockState = OTA_BLOCK_RECEIVING;
+        }
+    } else if(raw.status == RAW_WRITE && blockState == OTA_BLOCK_RECEIVING){
+        if(blockRaw){
+            if(blockRawLen + raw.currentSize > decoder.outSize){
+                blockState = OTA_BLOCK_REJECTED;
+                blockError = "block too long";
+                return;
+            }
+            memcpy(block + blockRawLen, raw.buf, raw.currentSize);
+            blockRawLen += raw.currentSize;
+        } else if(!espIOTLibOTADecoderFeed(&decoder, raw.buf, raw.currentSize)){
+            blockState = OTA_BLOCK_REJECTED;
+            blockError = "corrupt block";
+        }
+    } else if(raw.status == RAW_ABORTED){
+        blockState = OTA_BLOCK_NONE;
+    }
+}
+
+void handleOTABlock(){
+    if(!espIOTLibOTAAuthenticate()){
+        return server->requestAuthentication();
+    }
+    uint8_t state = blockState;
+    blockState = OTA_BLOCK_NONE;
+    if(state == OTA_BLOCK_DUPLICATE){
+        return espIOTLibOTAStatus(200, NULL);
+    } else if(state == OTA_BLOCK_REJECTED){
+        return espIOTLibOTAStatus(409, blockError);
+    } else if(state != OTA_BLOCK_RECEIVING){
+        return espIOTLibOTAStatus(400, "no block data");
+    }
+
+    uint16_t len = blockRaw ? blockRawLen : decoder.outLen;
+    if(len != decoder.outSize){
+        return espIOTLibOTAStatus(400, "short block");
+    }
+    if(espIOTLibOTACrc32(0, block, len) != blockCrc){
+        return espIOTLibOTAStatus(400, "block crc");
+    }
+    uint32_t offset = blockIndex * ESP_IOTLIB_OTA_BLOCK_SIZE;
+    if(esp_partition_erase_range(partition, offset, ESP_IOTLIB_OTA_BLOCK_SIZE) != ESP_OK || esp_partition_write(partition, offset, block, len) != ESP_OK){
+        return espIOTLibOTAStatus(500, "flash write");
+    }
+    nextBlock++;
+    lastBlockCrc = blockCrc;
+    espIOTLibOTASave();
+    espIOTLibMarkActivity();
+    espIOTLibOTAStatus(200, NULL);
+}
+
+// Whole image CRC from flash, then let the bootloader check and take it
+void handleOTAFinish(){
+    if(!espIOTLibOTAAuthenticate()){
+        return server->requestAuthentication();
+    }
+    if(!active || nextBlock < OTA_BLOCKS(imageSize)){
+        return espIOTLibOTAStatus(409, "incomplete");
+    }
+    uint32_t crc = 0;
+    for(uint32_t index = 0; index < OTA_BLOCKS(imageSize); index++){
+        uint16_t len = espIOTLibOTABlockLen(index);
+        if(esp_partition_read(partition, index * ESP_IOTLIB_OTA_BLOCK_SIZE, block, len) != ESP_OK){
+            return espIOTLibOTAStatus(500, "flash read");
+        }
+        crc = espIOTLibOTACrc32(crc, block, len);
+    }
+    if(crc != imageCrc){
+        nextBlock = 0;
+        espIOTLibOTASave();
+        return espIOTLibOTAStatus(409, "image crc, start over");
+    }
+    if(esp_ota_set_boot_partition(partition) != ESP_OK){
+        espIOTLibOTAClear();
+        return espIOTLibOTAStatus(409, "invalid image");
+    }
+    nextBlock = OTA_BLOCKS(imageSize);
+    espIOTLibOTAStatus(200, NULL);
+    espIOTLibOTAClear();
+    ESP_IOTLIB_LOGI("OTA done, restarting\n");
+    delay(500);
+    ESP.restart();
+}
+
+void handleOTAAbort(){
+    if(!espIOTLibOTAAuthenticate()){
+        return server->requestAuthentication();
+    }
+    espIOTLibOTAClear();
+    espIOTLibOTAStatus(200, NULL);
+}
+#endif
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+void espIOTLibOTADecoderInit(espIOTLibOTADecoder *dec, uint8_t *out, uint16_t outSize){
+    dec->out = out;
+    dec->outSize = outSize;
+    dec->outLen = 0;
+    dec->bits = 0;
+    dec->bitCount = 0;
+    dec->error = false;
+}
+
+// Decode the next piece of a heatshrink stream, false once the stream is found to be invalid
+bool espIOTLibOTADecoderFeed(espIOTLibOTADecoder *dec, const uint8_t *data, size_t len){
+    const uint8_t backrefBits = 1 + ESP_IOTLIB_OTA_WINDOW_BITS + ESP_IOTLIB_OTA_LOOKAHEAD_BITS;
+    for(size_t i = 0; i < len && !dec->error; i++){
+        // At most backrefBits - 1 bits are pending, so 8 more always fit
+        dec->bits = (dec->bits << 8) | data[i];
+        dec->bitCount += 8;
+        while(dec->bitCount >= 9){
+            bool literal = (dec->bits >> (dec->bitCount - 1)) & 1;
+            if(literal){
+                if(dec->outLen >= dec->outSize){
+                    dec->error = true;
+                    break;
+                }
+                dec->out[dec->outLen++] = dec->bits >> (dec->bitCount - 9);
+                dec->bitCount -= 9;
+                continue;
+            }
+            if(dec->bitCount < backrefBits){
+                break;
+            }
+            dec->bitCount -= backrefBits;
+            uint16_t offset = ((dec->bits >> (dec->bitCount + ESP_IOTLIB_OTA_LOOKAHEAD_BITS)) & ((1 << ESP_IOTLIB_OTA_WINDOW_BITS) - 1)) + 1;
+            uint16_t count = ((dec->bits >> dec->bitCount) & ((1 << ESP_IOTLIB_OTA_LOOKAHEAD_BITS) - 1)) + 1;
+            if(offset > dec->outLen || dec->outLen + count > dec->outSize){
+                dec->error = true;
+                break;
+            }
+            // Byte by byte, the source may overlap the bytes being written
+            for(uint16_t n = 0; n < count; n++, dec->outLen++){
+                dec->out[dec->outLen] = dec->out[dec->outLen - offset];
+            }
+        }
+        dec->bits &= (1UL << dec->bitCount) - 1;
+    }
+    return !dec->error;
+}
+
+// CRC32 (IEEE, as zlib), start with crc = 0
+uint32_t espIOTLibOTACrc32(uint32_t crc, const uint8_t *data, size_t len){
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++){
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crcTable[crc & 0x0F];
+        crc = (crc >> 4) ^ crcTable[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+// Register the /ota endpoints and pick up an interrupted upload
+void espIOTLibEnableBlockOTA(){
+#if defined(ESP32)
+    server = espIOTLibGetWebServer();
+    server->on(ESP_IOTLIB_OTA_ENDPOINT "/status", HTTP_GET, handleOTAStatus);
+    server->on(ESP_IOTLIB_OTA_ENDPOINT "/begin", HTTP_POST, handleOTABegin);
+    server->on(ESP_IOTLIB_OTA_ENDPOINT "/block", HTTP_POST, handleOTABlock, handleOTABlockBody);
+    server->on(ESP_IOTLIB_OTA_ENDPOINT "/finish", HTTP_POST, handleOTAFinish);
+    server->on(ESP_IOTLIB_OTA_ENDPOINT "/abort", HTTP_POST, handleOTAAbort);
+
+    prefs.begin(OTA_PREFS_NAMESPACE);
+    imageSize = prefs.getUInt("size", 0);
+    imageCrc = prefs.getUInt("crc", 0);
+    nextBlock = prefs.getUInt("next", 0);
+    lastBlockCrc = prefs.getUInt("last", 0);
+    partition = esp_ota_get_next_update_partition(NULL);
+    active = (imageSize > 0 && partition && imageSize <= partition->size);
+    // Blocks written to the other slot (an update was booted since) are no base to continue from
+    if(active && prefs.getUInt("part", 0) != partition->address){
+        ESP_IOTLIB_LOGW("OTA upload was for another partition, starting over\n");
+        espIOTLibOTAClear();
+    }
+    if(active){
+        espIOTLibOTAVerifyResume();
+        ESP_IOTLIB_LOGI("OTA upload pending at block %u of %u\n", nextBlock, OTA_BLOCKS(imageSize));
+    }
+#else
+    ESP_IOTLIB_LOGW("Block OTA is only supported on ESP32\n");
+#endif
+}
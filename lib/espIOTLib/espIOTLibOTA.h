@@ -0,0 +1,58 @@
+/**
+ * @file espIOTLibOTA.h
+ * @author agent (agent@local)
+ * @brief Resumable OTA updates from compressed, individually checked blocks
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * The image is cut into ESP_IOTLIB_OTA_BLOCK_SIZE blocks (one flash sector), each compressed on
+ * its own with heatshrink (window / lookahead bits below) and sent with the CRC32 of its
+ * uncompressed data. A block is only written once it decompressed to the right size and CRC, and
+ * the next block index is kept in NVS, so an interrupted upload continues where it stopped:
+ *
+ *   GET  /ota/status                                 state, next block, parameters (JSON)
+ *   POST /ota/begin?size=<bytes>&crc=<crc32>         new upload, or resume of the same image
+ *   POST /ota/block?index=<n>&crc=<crc32>[&raw=1]    block body (octet-stream), raw = stored
+ *   POST /ota/finish                                 check the image CRC, boot it
+ *   POST /ota/abort                                  forget the upload
+ *
+ * All requests need the admin user and AP password, like the IotWebConf firmware updater.
+ * tools/ota_upload.py does the client side.
+ */
+#ifndef ESPIOTLIBOTA_H
+#define ESPIOTLIBOTA_H
+
+// --- Includes ---
+#include <Arduino.h>
+
+// --- Defines ---
+#define ESP_IOTLIB_OTA_BLOCK_SIZE 4096
+// heatshrink parameters, the decoder needs no memory beyond the block buffer
+#define ESP_IOTLIB_OTA_WINDOW_BITS 10
+#define ESP_IOTLIB_OTA_LOOKAHEAD_BITS 5
+#define ESP_IOTLIB_OTA_ENDPOINT "/ota"
+
+// --- Marcos ---
+
+// --- Typedefs ---
+// Streaming heatshrink decoder writing into a fixed buffer, back references point into the output
+typedef struct {
+    uint8_t *out;
+    uint16_t outSize;
+    uint16_t outLen;
+    uint32_t bits;      // Unconsumed input bits, right aligned
+    uint8_t bitCount;
+    bool error;         // Output overflow or back reference before the start
+} espIOTLibOTADecoder;
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+void espIOTLibOTADecoderInit(espIOTLibOTADecoder *dec, uint8_t *out, uint16_t outSize);
+bool espIOTLibOTADecoderFeed(espIOTLibOTADecoder *dec, const uint8_t *data, size_t len);
+uint32_t espIOTLibOTACrc32(uint32_t crc, const uint8_t *data, size_t len);
+void espIOTLibEnableBlockOTA();
+
+#endif /* ESPIOTLIBOTA_H */
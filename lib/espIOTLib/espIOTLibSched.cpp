@@ -0,0 +1,175 @@
+/**
+ * @file espIOTLibSched.cpp
+ * @author agent (agent@local)
+ * @brief Fixed-rate deadline scheduler for periodic jobs
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include "espIOTLibSched.h"
+#include "espIOTLib.h"
+
+#include <sys/time.h>
+
+// --- Defines ---
+#define SCHED_METRIC_NAME_LEN 64
+#define SCHED_METRIC_LABEL_LEN 48
+
+// --- Marcos ---
+
+// --- Typedefs ---
+
+// --- Private Vars ---
+static const uint16_t jitterBounds[ESP_IOTLIB_SCHED_JITTER_BUCKETS] = {0, 1, 2, 5, 10, 20, 50, 100, 200, 500};
+
+// --- Private Functions ---
+// Offset of a deadline from the wall clock grid of period, in (-period/2, period/2]. 0 while the clock is not set
+int32_t espIOTLibSchedGridError(uint32_t period, uint32_t lateness){
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if(tv.tv_sec < ESP_IOTLIB_SCHED_VALID_EPOCH){
+        return 0;
+    }
+    uint64_t deadlineMs = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - lateness;
+    int32_t error = deadlineMs % period;
+    if(error > (int32_t)(period / 2)){
+        error -= period;
+    }
+    return error;
+}
+
+void espIOTLibSchedRecordJitter(espIOTLibJob *job, uint32_t lateness){
+    uint8_t bucket = 0;
+    while(bucket < ESP_IOTLIB_SCHED_JITTER_BUCKETS && lateness > jitterBounds[bucket]){
+        bucket++;
+    }
+    job->jitterHist[bucket]++;
+    job->jitterSum += lateness;
+    if(lateness > job->jitterMax){
+        job->jitterMax = lateness;
+    }
+}
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+// Add a job running every period ms, first run one period from now. Returns the job id or -1
+int8_t espIOTLibSchedAdd(espIOTLibSched *sched, const char *name, uint32_t period, espIOTLibSchedPolicy policy, espIOTLibJobFn fn, void *arg){
+    if(!sched || !fn || sched->count >= ESP_IOTLIB_SCHED_MAX_JOBS){
+        return -1;
+    }
+    espIOTLibJob *job = &sched->jobs[sched->count];
+    memset(job, 0, sizeof(espIOTLibJob));
+    job->name = name;
+    job->fn = fn;
+    job->arg = arg;
+    job->policy = policy;
+    job->period = period;
+    job->next = millis() + period;
+    return sched->count++;
+}
+
+// Change the period (0 disables the job), the new grid starts now
+void espIOTLibSchedSetPeriod(espIOTLibSched *sched, int8_t id, uint32_t period){
+    if(!sched || id < 0 || id >= sched->count){
+        return;
+    }
+    espIOTLibJob *job = &sched->jobs[id];
+    job->period = period;
+    job->next = millis() + period;
+}
+
+// Run the job once on the next pass without moving its grid
+void espIOTLibSchedTrigger(espIOTLibSched *sched, int8_t id){
+    if(!sched || id < 0 || id >= sched->count){
+        return;
+    }
+    sched->jobs[id].triggered = true;
+}
+
+// Run all due jobs, returns the earliest upcoming deadline (millis)
+uint32_t espIOTLibSchedRun(espIOTLibSched *sched){
+    uint32_t now = millis();
+    for(uint8_t i = 0; i < sched->count; i++){
+        espIOTLibJob *job = &sched->jobs[i];
+        if(job->triggered){
+            job->triggered = false;
+            job->fn(job->arg);
+            now = millis();
+        }
+        if(!job->period || (int32_t)(now - job->next) < 0){
+            continue;
+        }
+        uint32_t lateness = now - job->next;
+        espIOTLibSchedRecordJitter(job, lateness);
+        // Next deadline follows from the previous one, never from when we got around to it
+        job->next += job->period - espIOTLibSchedGridError(job->period, lateness);
+        job->runs++;
+        job->fn(job->arg);
+
+        now = millis();
+        if((int32_t)(now - job->next) >= 0 && job->policy == ESP_IOTLIB_SCHED_SKIP){
+            uint32_t missed = (now - job->next) / job->period + 1;
+            job->next += missed * job->period;
+            job->skipped += missed;
+        }
+    }
+
+    uint32_t deadline = now + INT32_MAX;
+    for(uint8_t i = 0; i < sched->count; i++){
+        espIOTLibJob *job = &sched->jobs[i];
+        if(job->triggered){
+            return now;
+        }
+        if(job->period && (int32_t)(job->next - deadline) < 0){
+            deadline = job->next;
+        }
+    }
+    return deadline;
+}
+
+// Start jitter histograms in seconds and skip counters (only valid inside a metrics CB)
+void espIOTLibSchedMetrics(espIOTLibSched *sched, const char *prefix){
+    char name[SCHED_METRIC_NAME_LEN];
+    char labels[SCHED_METRIC_LABEL_LEN];
+
+    snprintf(name, sizeof(name), "%ssched_start_jitter_seconds", prefix);
+    espIOTLibMetricHeader(name, "histogram", "Lateness of job starts against their deadline");
+    for(uint8_t i = 0; i < sched->count; i++){
+        espIOTLibJob *job = &sched->jobs[i];
+        uint32_t cumulative = 0;
+        snprintf(name, sizeof(name), "%ssched_start_jitter_seconds_bucket", prefix);
+        for(uint8_t b = 0; b <= ESP_IOTLIB_SCHED_JITTER_BUCKETS; b++){
+            cumulative += job->jitterHist[b];
+            if(b < ESP_IOTLIB_SCHED_JITTER_BUCKETS){
+                snprintf(labels, sizeof(labels), "job=\"%s\",le=\"%g\"", job->name, jitterBounds[b] / 1000.0);
+            } else {
+                snprintf(labels, sizeof(labels), "job=\"%s\",le=\"+Inf\"", job->name);
+            }
+            espIOTLibMetricValue(name, labels, cumulative);
+        }
+        snprintf(labels, sizeof(labels), "job=\"%s\"", job->name);
+        snprintf(name, sizeof(name), "%ssched_start_jitter_seconds_sum", prefix);
+        espIOTLibMetricValue(name, labels, job->jitterSum / 1000.0);
+        snprintf(name, sizeof(name), "%ssched_start_jitter_seconds_count", prefix);
+        espIOTLibMetricValue(name, labels, cumulative);
+    }
+
+    snprintf(name, sizeof(name), "%ssched_start_jitter_max_seconds", prefix);
+    espIOTLibMetricHeader(name, "gauge", "Largest start lateness since boot");
+    for(uint8_t i = 0; i < sched->count; i++){
+        snprintf(labels, sizeof(labels), "job=\"%s\"", sched->jobs[i].name);
+        espIOTLibMetricValue(name, labels, sched->jobs[i].jitterMax / 1000.0);
+    }
+
+    snprintf(name, sizeof(name), "%ssched_skipped_total", prefix);
+    espIOTLibMetricHeader(name, "counter", "Periods dropped because the job ran late");
+    for(uint8_t i = 0; i < sched->count; i++){
+        snprintf(labels, sizeof(labels), "job=\"%s\"", sched->jobs[i].name);
+        espIOTLibMetricValue(name, labels, sched->jobs[i].skipped);
+    }
+}
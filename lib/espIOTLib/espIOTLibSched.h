@@ -0,0 +1,65 @@
+/**
+ * @file espIOTLibSched.h
+ * @author agent (agent@local)
+ * @brief Fixed-rate deadline scheduler for periodic jobs
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef ESPIOTLIBSCHED_H
+#define ESPIOTLIBSCHED_H
+
+// --- Includes ---
+#include <Arduino.h>
+
+// --- Defines ---
+#ifndef ESP_IOTLIB_SCHED_MAX_JOBS
+    #define ESP_IOTLIB_SCHED_MAX_JOBS 8
+#endif
+// Start jitter histogram buckets (upper bounds in ms, exported in seconds, +Inf is implicit)
+#define ESP_IOTLIB_SCHED_JITTER_BUCKETS 10
+// Wall clock is considered valid after this (2020-01-01), then jobs run on a grid of the epoch
+#define ESP_IOTLIB_SCHED_VALID_EPOCH 1577836800
+
+// --- Marcos ---
+
+// --- Typedefs ---
+typedef void (*espIOTLibJobFn)(void *arg);
+
+typedef enum {
+    ESP_IOTLIB_SCHED_CATCH_UP, // Run missed periods back to back
+    ESP_IOTLIB_SCHED_SKIP      // Drop missed periods, continue on the grid
+} espIOTLibSchedPolicy;
+
+typedef struct {
+    const char *name;
+    espIOTLibJobFn fn;
+    void *arg;
+    uint32_t period;     // ms, 0 = disabled
+    uint32_t next;       // millis() deadline
+    espIOTLibSchedPolicy policy;
+    bool triggered;      // Extra run requested via espIOTLibSchedTrigger()
+    uint32_t runs;
+    uint32_t skipped;
+    uint32_t jitterSum;  // ms
+    uint32_t jitterMax;  // ms
+    uint32_t jitterHist[ESP_IOTLIB_SCHED_JITTER_BUCKETS + 1];
+} espIOTLibJob;
+
+typedef struct {
+    espIOTLibJob jobs[ESP_IOTLIB_SCHED_MAX_JOBS];
+    uint8_t count;
+} espIOTLibSched;
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+int8_t espIOTLibSchedAdd(espIOTLibSched *sched, const char *name, uint32_t period, espIOTLibSchedPolicy policy, espIOTLibJobFn fn, void *arg);
+void espIOTLibSchedSetPeriod(espIOTLibSched *sched, int8_t id, uint32_t period);
+void espIOTLibSchedTrigger(espIOTLibSched *sched, int8_t id);
+uint32_t espIOTLibSchedRun(espIOTLibSched *sched);
+void espIOTLibSchedMetrics(espIOTLibSched *sched, const char *prefix);
+
+#endif /* ESPIOTLIBSCHED_H */
@@ -0,0 +1,329 @@
+/**
+ * @file burstCapture.cpp
+ * @author agent (agent@local)
+ * @brief Event-triggered high rate capture of a small register block
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include "burstCapture.h"
+#include "regDecode.h"
+#include "espIOTLib.h"
+
+#include <sys/time.h>
+
+// --- Defines ---
+// Worst case size of one zigzag varint
+#define BURST_VARINT_MAX 5
+// Values are sent in 1/1000 units, clamped so deltas fit in 32 bit
+#define BURST_QUANT 1000.0f
+#define BURST_QUANT_MAX 1000000000L
+// MQTT fixed header, topic length and packet id next to the payload
+#define BURST_MQTT_OVERHEAD 8
+#define BURST_METRIC_NAME_LEN 64
+
+// --- Marcos ---
+
+// --- Typedefs ---
+
+// --- Private Vars ---
+static const char *captureTopic = NULL;
+static mbGatewayReadFn busRead = NULL;
+static espIOTLibSched *burstSched = NULL;
+static int8_t burstJob = -1;
+static uint8_t busUnit = 1;
+static uint16_t blockAddr = 0;
+static uint8_t blockChannels = 0;
+static burstTrigger *trig = NULL;
+static uint8_t trigCount = 0;
+static uint32_t watchPeriod = BURST_WATCH_PERIOD_MS;
+static uint32_t window = BURST_WINDOW_MS;
+static uint32_t capturePeriod = BURST_WINDOW_MS / (BURST_MAX_SAMPLES - BURST_PRE_SAMPLES);
+
+    // Pre trigger ring
+static float ring[BURST_PRE_SAMPLES][BURST_MAX_CHANNELS];
+static uint32_t ringTime[BURST_PRE_SAMPLES];
+static uint8_t ringNext = 0;
+static uint8_t ringCount = 0;
+
+    // Trace of the running capture
+static float trace[BURST_MAX_SAMPLES][BURST_MAX_CHANNELS];
+static uint32_t traceTime[BURST_MAX_SAMPLES];
+static uint16_t traceCount = 0;
+static uint16_t tracePre = 0;
+static bool capturing = false;
+static uint8_t captureTrigger = BURST_NO_TRIGGER;
+static uint32_t triggerTime = 0;
+static uint32_t triggerEpoch = 0;
+static uint16_t triggerEpochMs = 0;
+static bool holdoff = false;
+static uint32_t holdoffUntil = 0;
+
+    // Statistics
+static uint32_t statTriggers[BURST_MAX_TRIGGERS];
+static uint32_t statCaptures = 0;
+static uint32_t statDropped = 0;
+static uint32_t statReadErrors = 0;
+static uint16_t statLastSamples = 0;
+static uint16_t statLastBytes = 0;
+
+// --- Private Functions ---
+uint8_t *burstPutVarint(uint8_t *out, int32_t value){
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (value < 0 ? 0xFFFFFFFFUL : 0);
+    while(zigzag >= 0x80){
+        *out++ = (zigzag & 0x7F) | 0x80;
+        zigzag >>= 7;
+    }
+    *out++ = zigzag;
+    return out;
+}
+
+uint8_t *burstPutLE(uint8_t *out, uint32_t value, uint8_t bytes){
+    for(uint8_t i = 0; i < bytes; i++){
+        *out++ = value >> (8 * i);
+    }
+    return out;
+}
+
+int32_t burstQuantize(float value){
+    if(isnan(value)){
+        return 0;
+    }
+    float scaled = value * BURST_QUANT;
+    if(scaled > BURST_QUANT_MAX){
+        return BURST_QUANT_MAX;
+    }
+    if(scaled < -BURST_QUANT_MAX){
+        return -BURST_QUANT_MAX;
+    }
+    return lroundf(scaled);
+}
+
+// Encode the trace into out, drops trailing samples that do not fit. Returns the length
+uint16_t burstEncode(uint8_t *out, uint16_t maxLen, uint16_t *samples){
+    uint8_t *p = out;
+    int32_t last[BURST_MAX_CHANNELS] = {0};
+    uint32_t lastTime = triggerTime;
+
+    *p++ = BURST_FORMAT_VERSION;
+    *p++ = captureTrigger;
+    *p++ = busUnit;
+    p = burstPutLE(p, blockAddr, 2);
+    *p++ = blockChannels;
+    uint8_t *countField = p;
+    p += 2;
+    p = burstPutLE(p, tracePre, 2);
+    p = burstPutLE(p, triggerEpoch, 4);
+    p = burstPutLE(p, triggerEpochMs, 2);
+
+    uint16_t n = 0;
+    while(n < traceCount && (p - out) + BURST_VARINT_MAX * (1 + blockChannels) <= maxLen){
+        p = burstPutVarint(p, (int32_t)(traceTime[n] - lastTime));
+        lastTime = traceTime[n];
+        for(uint8_t c = 0; c < blockChannels; c++){
+            int32_t q = burstQuantize(trace[n][c]);
+            p = burstPutVarint(p, q - last[c]);
+            last[c] = q;
+        }
+        n++;
+    }
+    burstPutLE(countField, n, 2);
+    *samples = n;
+    return p - out;
+}
+
+// Index of the first trigger that fires for sample v, -1 if none
+int8_t burstCheck(uint32_t now, const float *v){
+    const float *prev = NULL;
+    uint32_t dt = 0;
+    if(ringCount){
+        uint8_t last = (ringNext + BURST_PRE_SAMPLES - 1) % BURST_PRE_SAMPLES;
+        prev = ring[last];
+        dt = now - ringTime[last];
+    }
+    for(uint8_t t = 0; t < trigCount; t++){
+        burstTrigger *tr = &trig[t];
+        if(tr->level <= 0 || tr->channels == 0 || tr->channel + tr->channels > blockChannels){
+            continue;
+        }
+        float minValue = v[tr->channel];
+        float maxValue = v[tr->channel];
+        float sum = 0;
+        bool fired = false;
+        for(uint8_t c = tr->channel; c < tr->channel + tr->channels; c++){
+            if(tr->type == BURST_TRIG_ABOVE && v[c] > tr->level){
+                fired = true;
+            } else if(tr->type == BURST_TRIG_RATE && prev && dt && fabsf(v[c] - prev[c]) * 1000.0f / dt > tr->level){
+                fired = true;
+            }
+            minValue = fminf(minValue, v[c]);
+            maxValue = fmaxf(maxValue, v[c]);
+            sum += v[c];
+        }
+        if(tr->type == BURST_TRIG_IMBALANCE){
+            float mean = sum / tr->channels;
+            fired = (mean >= BURST_IMBALANCE_MIN_MEAN && (maxValue - minValue) * 100.0f / mean > tr->level);
+        }
+        if(fired){
+            return t;
+        }
+    }
+    return -1;
+}
+
+void burstRingPush(uint32_t now, const float *v){
+    memcpy(ring[ringNext], v, blockChannels * sizeof(float));
+    ringTime[ringNext] = now;
+    ringNext = (ringNext + 1) % BURST_PRE_SAMPLES;
+    if(ringCount < BURST_PRE_SAMPLES){
+        ringCount++;
+    }
+}
+
+void burstAppend(uint32_t now, const float *v){
+    memcpy(trace[traceCount], v, blockChannels * sizeof(float));
+    traceTime[traceCount] = now;
+    traceCount++;
+}
+
+// Trigger sample is the newest ring entry, the trace starts with the whole ring
+void burstStart(uint32_t now, uint8_t t){
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    bool clockValid = (tv.tv_sec >= ESP_IOTLIB_SCHED_VALID_EPOCH);
+    triggerEpoch = clockValid ? tv.tv_sec : 0;
+    triggerEpochMs = clockValid ? tv.tv_usec / 1000 : 0;
+    triggerTime = now;
+    captureTrigger = t;
+    statTriggers[t]++;
+
+    traceCount = 0;
+    uint8_t first = (ringNext + BURST_PRE_SAMPLES - ringCount) % BURST_PRE_SAMPLES;
+    for(uint8_t i = 0; i < ringCount; i++){
+        uint8_t index = (first + i) % BURST_PRE_SAMPLES;
+        burstAppend(ringTime[index], ring[index]);
+    }
+    tracePre = traceCount - 1;
+    capturing = true;
+    espIOTLibSchedSetPeriod(burstSched, burstJob, capturePeriod);
+    ESP_IOTLIB_LOGI("Burst capture started by trigger %u\n", t);
+}
+
+void burstFinish(uint32_t now){
+    capturing = false;
+    ringCount = 0;
+    holdoff = true;
+    holdoffUntil = now + BURST_HOLDOFF_MS;
+    espIOTLibSchedSetPeriod(burstSched, burstJob, watchPeriod);
+
+    uint8_t *msg = (uint8_t *)espIOTLibMQTTMsgAcquire();
+    if(!msg){
+        statDropped++;
+        ESP_IOTLIB_LOGW("No buffer for burst capture, %u samples dropped\n", traceCount);
+        return;
+    }
+    uint16_t samples;
+    uint16_t len = burstEncode(msg, ESP_IOTLIB_MQTT_BUFFER_SIZE - strlen(captureTopic) - BURST_MQTT_OVERHEAD, &samples);
+    espIOTLibPublishBin(captureTopic, msg, len);
+    espIOTLibMQTTMsgRelease((char *)msg);
+    statCaptures++;
+    statLastSamples = samples;
+    statLastBytes = len;
+    if(samples < traceCount){
+        ESP_IOTLIB_LOGW("Burst capture truncated to %u of %u samples\n", samples, traceCount);
+    }
+    ESP_IOTLIB_LOGI("Burst capture sent: %u samples in %u bytes\n", samples, len);
+}
+
+void burstSample(void *arg){
+    uint8_t raw[4 * BURST_MAX_CHANNELS];
+    float v[BURST_MAX_CHANNELS];
+    if(busRead(busUnit, 0x03, blockAddr, 2 * blockChannels, raw) != 0){
+        statReadErrors++;
+        return;
+    }
+    regDecodeFloat32(raw, blockChannels, REG_ORDER_ABCD, v);
+    uint32_t now = millis();
+
+    if(capturing){
+        burstAppend(now, v);
+        if(traceCount >= BURST_MAX_SAMPLES || now - triggerTime >= window){
+            burstFinish(now);
+        }
+        return;
+    }
+    if(holdoff && (int32_t)(now - holdoffUntil) >= 0){
+        holdoff = false;
+    }
+    // Rate triggers compare against the previous sample, so check before pushing
+    int8_t t = holdoff ? -1 : burstCheck(now, v);
+    burstRingPush(now, v);
+    if(t >= 0){
+        burstStart(now, t);
+    }
+}
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+// Watch channels float32 registers from addr of unit, publish captures to topic. triggers stay owned by the caller (levels may change)
+void burstBegin(const char *topic, mbGatewayReadFn readFn, espIOTLibSched *sched, uint8_t unit, uint16_t addr, uint8_t channels, burstTrigger *triggers, uint8_t triggerCount){
+    captureTopic = topic;
+    busRead = readFn;
+    burstSched = sched;
+    busUnit = unit;
+    blockAddr = addr;
+    blockChannels = channels < BURST_MAX_CHANNELS ? channels : BURST_MAX_CHANNELS;
+    trig = triggers;
+    trigCount = triggerCount < BURST_MAX_TRIGGERS ? triggerCount : BURST_MAX_TRIGGERS;
+    burstJob = espIOTLibSchedAdd(sched, "burst", watchPeriod, ESP_IOTLIB_SCHED_SKIP, burstSample, NULL);
+}
+
+// Watch period (ms, 0 stops watching) and capture window (ms). Without an enabled trigger nothing is watched
+void burstSetTiming(uint32_t watch, uint32_t captureWindow){
+    bool armed = false;
+    for(uint8_t t = 0; t < trigCount; t++){
+        armed |= (trig[t].level > 0);
+    }
+    watchPeriod = armed ? watch : 0;
+    window = captureWindow;
+    // Samples after the trigger that fit into the trace
+    capturePeriod = window / (BURST_MAX_SAMPLES - BURST_PRE_SAMPLES);
+    if(capturePeriod < BURST_CAPTURE_MIN_PERIOD_MS){
+        capturePeriod = BURST_CAPTURE_MIN_PERIOD_MS;
+    }
+    if(!capturing){
+        ringCount = 0;
+        espIOTLibSchedSetPeriod(burstSched, burstJob, watchPeriod);
+    }
+}
+
+// True while the bus is reserved for a capture
+bool burstActive(){
+    return capturing;
+}
+
+void burstMetrics(const char *prefix){
+    char name[BURST_METRIC_NAME_LEN];
+    char labels[16];
+    snprintf(name, sizeof(name), "%sburst_triggers_total", prefix);
+    espIOTLibMetricHeader(name, "counter", "Burst captures started, by trigger index");
+    for(uint8_t t = 0; t < trigCount; t++){
+        snprintf(labels, sizeof(labels), "trigger=\"%u\"", t);
+        espIOTLibMetricValue(name, labels, statTriggers[t]);
+    }
+    snprintf(name, sizeof(name), "%sburst_captures_total", prefix);
+    espIOTLibMetric(name, "counter", "Burst captures published", statCaptures);
+    snprintf(name, sizeof(name), "%sburst_dropped_total", prefix);
+    espIOTLibMetric(name, "counter", "Burst captures dropped for lack of a message buffer", statDropped);
+    snprintf(name, sizeof(name), "%sburst_read_errors_total", prefix);
+    espIOTLibMetric(name, "counter", "Failed reads of the watched block", statReadErrors);
+    snprintf(name, sizeof(name), "%sburst_last_samples", prefix);
+    espIOTLibMetric(name, "gauge", "Samples in the last burst capture", statLastSamples);
+    snprintf(name, sizeof(name), "%sburst_last_bytes", prefix);
+    espIOTLibMetric(name, "gauge", "Size of the last burst capture message", statLastBytes);
+}
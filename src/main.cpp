@@ -1,7 +1,14 @@
 #include <Arduino.h>
 #include <ArduinoOTA.h>
 #include "espIOTLib.h"
-#include "modbus-rtu.h"
+#include <IotWebConfUsing.h>
+#include "espIOTLibSched.h"
+#include "espIOTLibOTA.h"
+#include "mbBus.h"
+#include "mbGateway.h"
+#include "mqttCommands.h"
+#include "regDecode.h"
+#include "burstCapture.h"
 
 #define NAME "ESP32-MID"
 #define VERSION "V1.0.1"
@@ -15,60 +22,169 @@
 #define MQTT_PASS "[XXX]"
 
 #define MQTT_TOPIC_MEAS_DATA "/user/[XXX]/grafana/wagoMID/measurements"
+#define MQTT_TOPIC_HEAP "/user/[XXX]/grafana/wagoMID/heap"
+#define MQTT_TOPIC_CMD "/user/[XXX]/grafana/wagoMID/cmd"
+#define MQTT_TOPIC_CMD_REPLY "/user/[XXX]/grafana/wagoMID/cmd/reply"
+#define MQTT_TOPIC_CAPTURE "/user/[XXX]/grafana/wagoMID/capture"
+#define MQTT_TOPIC_BUS_DATA "/user/[XXX]/grafana/wagoMID/bus"
+
+#define METRICS_PREFIX "wago_mid_"
 
 #define TIME_DIFFERENCE_STATE 30*1000
 
+// Wall clock for aligning the poll grid with other meters
+#define NTP_SERVER "pool.ntp.org"
+
 #define PIN_RX 16
 #define PIN_TX 18
+#define PIN_DE 39 // unused
+
+// Second bus on UART1, off by default
+#define BUS2_PIN_RX 33
+#define BUS2_PIN_TX 35
+#define BUS2_DEVICES_LEN 64
+#define BUS2_PERIOD_DEFAULT 10000
 
 #define PIN_LED 15
 
-// Times for the millis()-wait
-unsigned long oldTime = 0;
+// Modbus unit id of the MID meter
+#define METER_UNIT 0x01
+// A poll whose results did not all come back within this is given up
+#define METER_POLL_TIMEOUT_MS 5000
+
+#define NUMBER_LEN 12
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+
+espIOTLibSched sched;
+int8_t pollJob = -1;
+int8_t meterBus = -1;
 
-ModbusRTU mb;
-uint8_t fBuf[8];
+// Modbus TCP gateway config
+char gatewayMaxAgeValue[NUMBER_LEN];
+IotWebConfParameterGroup gatewayGroup = IotWebConfParameterGroup("gateway", "Modbus TCP gateway");
+IotWebConfNumberParameter gatewayMaxAgeParam = IotWebConfNumberParameter("Max cache age (ms)", "gwMaxAge", gatewayMaxAgeValue, NUMBER_LEN, STRINGIFY(MB_GATEWAY_MAX_AGE_MS));
+
+// Burst capture config, trigger levels of 0 are off
+char burstWatchValue[NUMBER_LEN];
+char burstWindowValue[NUMBER_LEN];
+char burstPowerValue[NUMBER_LEN];
+char burstRateValue[NUMBER_LEN];
+char burstImbalanceValue[NUMBER_LEN];
+IotWebConfParameterGroup burstGroup = IotWebConfParameterGroup("burst", "Burst capture");
+IotWebConfNumberParameter burstWatchParam = IotWebConfNumberParameter("Watch period (ms, 0 = off)", "burstWatch", burstWatchValue, NUMBER_LEN, STRINGIFY(BURST_WATCH_PERIOD_MS));
+IotWebConfNumberParameter burstWindowParam = IotWebConfNumberParameter("Capture window (ms)", "burstWindow", burstWindowValue, NUMBER_LEN, STRINGIFY(BURST_WINDOW_MS));
+IotWebConfNumberParameter burstPowerParam = IotWebConfNumberParameter("Total power above", "burstPower", burstPowerValue, NUMBER_LEN, "0", NULL, "step='any'");
+IotWebConfNumberParameter burstRateParam = IotWebConfNumberParameter("Phase current change per second above", "burstRate", burstRateValue, NUMBER_LEN, "0", NULL, "step='any'");
+IotWebConfNumberParameter burstImbalanceParam = IotWebConfNumberParameter("Phase current imbalance above (%)", "burstImb", burstImbalanceValue, NUMBER_LEN, "0", NULL, "step='any'");
+
+// Second bus config, applied on restart. Devices: "unit:addr:count[:period ms[:fc]]" separated by spaces
+char bus2BaudValue[NUMBER_LEN];
+char bus2FormatValue[NUMBER_LEN];
+char bus2RxValue[NUMBER_LEN];
+char bus2TxValue[NUMBER_LEN];
+char bus2DeValue[NUMBER_LEN];
+char bus2DevicesValue[BUS2_DEVICES_LEN];
+IotWebConfParameterGroup bus2Group = IotWebConfParameterGroup("bus2", "Second RS-485 bus");
+IotWebConfNumberParameter bus2BaudParam = IotWebConfNumberParameter("Baud (0 = off)", "bus2Baud", bus2BaudValue, NUMBER_LEN, "0");
+IotWebConfTextParameter bus2FormatParam = IotWebConfTextParameter("Format (8N1, 8E1, 8O1, 8N2)", "bus2Format", bus2FormatValue, NUMBER_LEN, "8E1");
+IotWebConfNumberParameter bus2RxParam = IotWebConfNumberParameter("RX pin", "bus2Rx", bus2RxValue, NUMBER_LEN, STRINGIFY(BUS2_PIN_RX));
+IotWebConfNumberParameter bus2TxParam = IotWebConfNumberParameter("TX pin", "bus2Tx", bus2TxValue, NUMBER_LEN, STRINGIFY(BUS2_PIN_TX));
+IotWebConfNumberParameter bus2DeParam = IotWebConfNumberParameter("DE pin (-1 = none)", "bus2De", bus2DeValue, NUMBER_LEN, "-1");
+IotWebConfTextParameter bus2DevicesParam = IotWebConfTextParameter("Devices (unit:addr:count[:period[:fc]])", "bus2Dev", bus2DevicesValue, BUS2_DEVICES_LEN, "");
 WebServer *server;
 char buf[1024];
 
 
-const uint16_t regs[] = {
+typedef struct {
+  uint16_t addr;
+  const char *key;    // JSON key
+  const char *metric; // Prometheus metric name (without prefix)
+  const char *phase;
+} meterReg_t;
+
+const meterReg_t regs[] = {
   // Currents
-  0x500C,
-  0x500E,
-  0x5010,
+  {0x500C, "curL1", "current", "L1"},
+  {0x500E, "curL2", "current", "L2"},
+  {0x5010, "curL3", "current", "L3"},
   // Voltages
-  0x5002,
-  0x5004,
-  0x5006,
+  {0x5002, "voltL1", "voltage", "L1"},
+  {0x5004, "voltL2", "voltage", "L2"},
+  {0x5006, "voltL3", "voltage", "L3"},
   // Power
-  0x5014,
-  0x5016,
-  0x5018,
+  {0x5014, "powerL1", "power", "L1"},
+  {0x5016, "powerL2", "power", "L2"},
+  {0x5018, "powerL3", "power", "L3"},
   // Total Power
-  0x5012,
+  {0x5012, "powerTotal", "power", "total"},
   // Frequency
-  0x5008,
+  {0x5008, "freqL1", "frequency", "L1"},
   // Power Factor
-  0x502C,
-  0x502E,
-  0x5030,
+  {0x502C, "pfL1", "power_factor", "L1"},
+  {0x502E, "pfL2", "power_factor", "L2"},
+  {0x5030, "pfL3", "power_factor", "L3"},
 
   // Energy sum (kWh)
-  0x6000, 
-  0x6006, 
-  0x6008, 
-  0x600A,
+  {0x6000, "energyTotal", "energy_kwh", "total"},
+  {0x6006, "energyL1", "energy_kwh", "L1"},
+  {0x6008, "energyL2", "energy_kwh", "L2"},
+  {0x600A, "energyL3", "energy_kwh", "L3"},
   // Energy drawn (kWh)
-  0x600C, 
-  0x6012, 
-  0x6014, 
-  0x6016,
+  {0x600C, "d_energyTotal", "drawn_energy_kwh", "total"},
+  {0x6012, "d_energyL1", "drawn_energy_kwh", "L1"},
+  {0x6014, "d_energyL2", "drawn_energy_kwh", "L2"},
+  {0x6016, "d_energyL3", "drawn_energy_kwh", "L3"},
+};
+#define REG_COUNT (sizeof(regs)/sizeof(meterReg_t))
+
+// Contiguous ranges covering regs, each read in one transaction
+typedef struct {
+  uint16_t addr;
+  uint16_t count;
+} meterBlock_t;
+
+const meterBlock_t blocks[] = {
+  {0x5002, 24}, // Voltage ... power L3
+  {0x502C, 6},  // Power factors
+  {0x6000, 24}, // Energy counters
+};
+#define BLOCK_COUNT (sizeof(blocks)/sizeof(meterBlock_t))
+#define BLOCK_REGS (24 + 6 + 24)
+// A rejected block is tried again after this many polls
+#define BLOCK_RETRY_POLLS 10
+
+// Raw registers of all blocks back to back
+uint8_t blockBuf[2*BLOCK_REGS];
+uint16_t blockStart[BLOCK_COUNT];
+// Polls left in which a block the meter rejected is read value by value, 0 = read as block
+uint8_t blockRetry[BLOCK_COUNT];
+// First register of each value in blockBuf
+uint16_t regOffset[REG_COUNT];
+uint8_t regBlock[REG_COUNT];
+bool regValid[REG_COUNT];
+// Reads of the current poll still on the meter's bus task
+uint8_t meterPending = 0;
+uint32_t meterPollStart;
+// Tag of the current poll's reads, results of earlier polls are dropped
+uint32_t meterPoll = 0;
+
+// Latest readings, NAN until read successfully
+float values[REG_COUNT];
+
+// Watched block 0x500C - 0x5013: curL1, curL2, curL3, powerTotal
+#define BURST_ADDR 0x500C
+#define BURST_CHANNELS 4
+burstTrigger burstTriggers[] = {
+  {BURST_TRIG_ABOVE, 3, 1, 0},
+  {BURST_TRIG_RATE, 0, 3, 0},
+  {BURST_TRIG_IMBALANCE, 0, 3, 0},
 };
 
 void wifi_connected() {
   // Connected to wifi
   digitalWrite(PIN_LED, LOW);
+  configTime(0, 0, NTP_SERVER);
 }
 
 void printHex(uint8_t *data, size_t size) {
@@ -80,81 +196,230 @@ void printHex(uint8_t *data, size_t size) {
 }
 
 
-float getFloat(uint16_t addr){
-  uint16_t fBufSize = sizeof(fBuf);
-  uint8_t error = mb.rs485_read(0x01,0x03,addr, 0x0002,fBuf,&fBufSize);
-    if(error != 0 || fBufSize != 4){
-      Serial.printf("error: 0x%x \n",error);
-      String error_msg = mb.getLastError();
-      if(error_msg != "")
-        Serial.println("error msg: "+error_msg);
-      return NAN;
-    }
-  uint8_t fBuf2[4];
-  fBuf2[0] = fBuf[3];
-  fBuf2[1] = fBuf[2];
-  fBuf2[2] = fBuf[1];
-  fBuf2[3] = fBuf[0];
-
-  return *((float*)fBuf2);
-}
-
-void getData(){
-  const uint8_t len = sizeof(regs)/sizeof(uint16_t);
-  float values[len];
-  for(uint8_t i=0; i<len; i++){
-    values[i] = getFloat(regs[i]);
-  }
-  buf[0] = '\0';
-  int num_chars = sprintf(buf,
-"{\
-\"curL1\": %f,\
-\"curL2\": %f,\
-\"curL3\": %f,\
-\"voltL1\": %f,\
-\"voltL2\": %f,\
-\"voltL3\": %f,\
-\"powerL1\": %f,\
-\"powerL2\": %f,\
-\"powerL3\": %f,\
-\"powerTotal\": %f,\
-\"freqL1\": %f,\
-\"pfL1\": %f,\
-\"pfL2\": %f,\
-\"pfL3\": %f,\
-\"energyTotal\": %f,\
-\"energyL1\": %f,\
-\"energyL2\": %f,\
-\"energyL3\": %f,\
-\"d_energyTotal\": %f,\
-\"d_energyL1\": %f,\
-\"d_energyL2\": %f,\
-\"d_energyL3\": %f,\
-}", 
-  values[0], values[1], values[2], 
-  values[3], values[4], values[5], 
-  values[6], values[7], values[8], values[9], 
-  values[10], 
-  values[11], values[12], values[13], 
-  values[14], values[15], values[16], values[17], 
-  values[18], values[19], values[20], values[21]
-  );
-  buf[num_chars] = '\0';
-  Serial.print("Measurements: ");
-  Serial.println(buf);
+// Place every reg in its block, all values are big endian float32
+void meterLayout(){
+  uint16_t start = 0;
+  for(uint8_t b=0; b<BLOCK_COUNT; b++){
+    blockStart[b] = start;
+    blockRetry[b] = 0;
+    start += blocks[b].count;
+  }
+  for(uint8_t i=0; i<REG_COUNT; i++){
+    regBlock[i] = 0;
+    for(uint8_t b=0; b<BLOCK_COUNT; b++){
+      if(regs[i].addr >= blocks[b].addr && regs[i].addr + 2 <= blocks[b].addr + blocks[b].count){
+        regBlock[i] = b;
+        break;
+      }
+    }
+    regOffset[i] = blockStart[regBlock[i]] + regs[i].addr - blocks[regBlock[i]].addr;
+  }
+}
+
+// Only an exception response means the meter does not serve the block, bus errors are retried on the next poll
+bool blockRejected(uint8_t error){
+  return error == MB_EX_ILLEGAL_FUNCTION || error == MB_EX_ILLEGAL_DATA_ADDRESS || error == MB_EX_ILLEGAL_DATA_VALUE;
+}
+
+// Queue a read for the meter's bus task, the result comes back through busResult()
+void meterSubmit(uint16_t addr, uint16_t count){
+  if(mbBusSubmit(meterBus, METER_UNIT, 0x03, addr, count, meterPoll) == 0){
+    meterPending++;
+  }
+}
+
+void submitValues(uint8_t b){
+  for(uint8_t i=0; i<REG_COUNT; i++){
+    if(regBlock[i] == b){
+      meterSubmit(regs[i].addr, 0x0002);
+    }
+  }
+}
+
+// Decode the poll and publish it, once all its reads are back
+void meterPublish(){
+  // Every value lies inside blockBuf (meterLayout()), no range checks or double conversions needed
+  regDecodeFloat32Gather(blockBuf, regOffset, REG_COUNT, REG_ORDER_ABCD, values);
+  for(uint8_t i=0; i<REG_COUNT; i++){
+    if(!regValid[i]){
+      values[i] = NAN;
+    }
+  }
+  int num_chars = snprintf(buf, sizeof(buf), "{");
+  for(uint8_t i=0; i<REG_COUNT && num_chars < (int)sizeof(buf); i++){
+    num_chars += snprintf(buf + num_chars, sizeof(buf) - num_chars, "\"%s\": %f,", regs[i].key, values[i]);
+  }
+  if(num_chars < (int)sizeof(buf) - 1){
+    buf[num_chars++] = '}';
+    buf[num_chars] = '\0';
+  }
+  ESP_IOTLIB_LOGD("Measurements: %s\n", buf);
   espIOTLibPublishStr(MQTT_TOPIC_MEAS_DATA, buf);
 }
 
+// A block or single value of the current poll, runs on the loop task
+void meterResult(const mbBusResult *result){
+  if(result->tag != meterPoll || !meterPending){
+    return; // Late answer to a poll that timed out
+  }
+  meterPending--;
+  for(uint8_t b=0; b<BLOCK_COUNT; b++){
+    if(result->addr != blocks[b].addr || result->count != blocks[b].count){
+      continue;
+    }
+    if(!result->exception){
+      memcpy(blockBuf + 2*blockStart[b], result->data, 2*blocks[b].count);
+    }
+    for(uint8_t i=0; i<REG_COUNT; i++){
+      if(regBlock[i] == b){
+        regValid[i] = (result->exception == 0);
+      }
+    }
+    if(blockRejected(result->exception)){
+      ESP_IOTLIB_LOGW("Block 0x%04X rejected (0x%02X), reading values one by one\n", blocks[b].addr, result->exception);
+      blockRetry[b] = BLOCK_RETRY_POLLS;
+      submitValues(b);
+    }
+    break;
+  }
+  if(result->count == 0x0002){
+    for(uint8_t i=0; i<REG_COUNT; i++){
+      if(regs[i].addr == result->addr){
+        if(!result->exception){
+          memcpy(blockBuf + 2*regOffset[i], result->data, 4);
+        }
+        regValid[i] = (result->exception == 0);
+        break;
+      }
+    }
+  }
+  if(!meterPending){
+    meterPublish();
+  }
+}
+
+void metrics(){
+  char labels[32];
+  mbBusMetrics(METRICS_PREFIX);
+  mbGatewayMetrics(METRICS_PREFIX);
+  espIOTLibSchedMetrics(&sched, METRICS_PREFIX);
+  burstMetrics(METRICS_PREFIX);
+
+  // Latest readings, one metric family per quantity
+  const char *family = NULL;
+  char name[48];
+  for(uint8_t i=0; i<REG_COUNT; i++){
+    snprintf(name, sizeof(name), METRICS_PREFIX "%s", regs[i].metric);
+    if(!family || strcmp(family, regs[i].metric) != 0){
+      espIOTLibMetricHeader(name, "gauge", "Latest meter reading");
+      family = regs[i].metric;
+    }
+    snprintf(labels, sizeof(labels), "phase=\"%s\",reg=\"0x%04X\"", regs[i].phase, regs[i].addr);
+    espIOTLibMetricValue(name, labels, values[i]);
+  }
+}
+
 void handleData(){
-  String s = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/>";
-  s += "<title>";
-  s += NAME;
-  s += " - Data</title></head><body><div><p>Data page of ";
-  s += NAME;
-  s += "</p><p>Got json from MID: ";
-  s += buf;
-  s += "</p></body></html>\n";
-  server->send(200, "text/html", s);
+  espIOTLibChunkBegin("text/html");
+  espIOTLibChunkPrintf("<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/>");
+  espIOTLibChunkPrintf("<title>%s - Data</title></head><body><div><p>Data page of %s", NAME, NAME);
+  espIOTLibChunkPrintf("</p><p>Got json from MID: ");
+  // The JSON alone nearly fills a chunk
+  espIOTLibChunkWrite(buf, strlen(buf));
+  espIOTLibChunkPrintf("</p></body></html>\n");
+  espIOTLibChunkEnd();
+}
+
+// Poll results of the bus tasks, published from the loop task
+void busResult(const mbBusResult *result){
+  if(result->bus == meterBus && result->unit == METER_UNIT){
+    meterResult(result);
+    return;
+  }
+  char *msg = espIOTLibMQTTMsgAcquire();
+  if(!msg){
+    ESP_IOTLIB_LOGW("No buffer for bus %s unit %u\n", mbBusName(result->bus), result->unit);
+    return;
+  }
+  int len = snprintf(msg, ESP_IOTLIB_MQTT_BUFFER_SIZE, "{\"bus\": \"%s\",\"unit\": %u,\"fc\": %u,\"addr\": %u,", mbBusName(result->bus), result->unit, result->fc, result->addr);
+  if(result->exception){
+    snprintf(msg + len, ESP_IOTLIB_MQTT_BUFFER_SIZE - len, "\"exception\": %u}", result->exception);
+  } else {
+    len += snprintf(msg + len, ESP_IOTLIB_MQTT_BUFFER_SIZE - len, "\"regs\": [");
+    for(uint16_t i=0; i<result->count; i++){
+      len += snprintf(msg + len, ESP_IOTLIB_MQTT_BUFFER_SIZE - len, "%s%u", i ? "," : "", (result->data[2*i] << 8) | result->data[2*i+1]);
+    }
+    snprintf(msg + len, ESP_IOTLIB_MQTT_BUFFER_SIZE - len, "]}");
+  }
+  espIOTLibPublishStr(MQTT_TOPIC_BUS_DATA, msg);
+  espIOTLibMQTTMsgRelease(msg);
+}
+
+// Bring up the second bus from the web config, if enabled
+void setupBus2(){
+  uint32_t baud = atol(bus2BaudValue);
+  if(!baud || !bus2DevicesValue[0]){
+    return;
+  }
+  int8_t bus = mbBusAdd("rs485-2", &Serial1, atoi(bus2RxValue), atoi(bus2TxValue), atoi(bus2DeValue), baud, mbBusSerialConfig(bus2FormatValue));
+  char devices[BUS2_DEVICES_LEN];
+  char *save;
+  strncpy(devices, bus2DevicesValue, sizeof(devices));
+  devices[sizeof(devices) - 1] = '\0';
+  for(char *dev = strtok_r(devices, " ,;", &save); dev; dev = strtok_r(NULL, " ,;", &save)){
+    uint32_t field[5] = {0, 0, 0, BUS2_PERIOD_DEFAULT, 0x03};
+    char *end = dev;
+    for(uint8_t f=0; f<5 && *end; f++){
+      field[f] = strtoul(end, &end, 0);
+      if(*end == ':'){
+        end++;
+      }
+    }
+    if(mbBusAddDevice(bus, field[0], field[4], field[1], field[2], field[3]) < 0){
+      ESP_IOTLIB_LOGW("Bus device '%s' rejected\n", dev);
+    }
+  }
+}
+
+// Apply web config values
+void configSaved(){
+  mbGatewaySetMaxAge(gatewayMaxAgeValue[0] ? atol(gatewayMaxAgeValue) : MB_GATEWAY_MAX_AGE_MS);
+  burstTriggers[0].level = atof(burstPowerValue);
+  burstTriggers[1].level = atof(burstRateValue);
+  burstTriggers[2].level = atof(burstImbalanceValue);
+  burstSetTiming(burstWatchValue[0] ? atol(burstWatchValue) : BURST_WATCH_PERIOD_MS, burstWindowValue[0] ? atol(burstWindowValue) : BURST_WINDOW_MS);
+}
+
+// Hand the meter's reads to its bus task, so they run alongside the second bus
+void pollData(void *arg){
+  // The bus belongs to a running burst capture, the next period polls again
+  if(burstActive()){
+    return;
+  }
+  if(meterPending){
+    if(millis() - meterPollStart < METER_POLL_TIMEOUT_MS){
+      return; // Previous poll still running
+    }
+    ESP_IOTLIB_LOGW("Meter poll timed out, %u reads missing\n", meterPending);
+    meterPending = 0;
+  }
+  meterPollStart = millis();
+  meterPoll++;
+  for(uint8_t i=0; i<REG_COUNT; i++){
+    regValid[i] = false;
+  }
+  for(uint8_t b=0; b<BLOCK_COUNT; b++){
+    if(!blockRetry[b]){
+      meterSubmit(blocks[b].addr, blocks[b].count);
+    } else {
+      blockRetry[b]--;
+      submitValues(b);
+    }
+  }
+  // Request queue full, publish what is there
+  if(!meterPending){
+    meterPublish();
+  }
 }
 
 void setup() {
@@ -170,13 +435,37 @@ void setup() {
 
   espIOTLibEnableMQTT(MQTT_SERVER, MQTT_USER, MQTT_PASS);
   espIOTLibEnableOTA(NULL);
+  espIOTLibEnableBlockOTA();
+  espIOTLibEnablePowerSave();
+  espIOTLibEnableHeapReport(MQTT_TOPIC_HEAP);
   server = espIOTLibGetWebServer();
   server->on("/data", handleData);
+  espIOTLibAddMetricsCB(&metrics);
+  gatewayGroup.addItem(&gatewayMaxAgeParam);
+  espIOTLibGetIotWebConf()->addParameterGroup(&gatewayGroup);
+  burstGroup.addItem(&burstWatchParam);
+  burstGroup.addItem(&burstWindowParam);
+  burstGroup.addItem(&burstPowerParam);
+  burstGroup.addItem(&burstRateParam);
+  burstGroup.addItem(&burstImbalanceParam);
+  espIOTLibGetIotWebConf()->addParameterGroup(&burstGroup);
+  bus2Group.addItem(&bus2BaudParam);
+  bus2Group.addItem(&bus2FormatParam);
+  bus2Group.addItem(&bus2RxParam);
+  bus2Group.addItem(&bus2TxParam);
+  bus2Group.addItem(&bus2DeParam);
+  bus2Group.addItem(&bus2DevicesParam);
+  espIOTLibGetIotWebConf()->addParameterGroup(&bus2Group);
+  espIOTLibGetIotWebConf()->setConfigSavedCallback(&configSaved);
+  for(uint8_t i=0; i<REG_COUNT; i++){
+    values[i] = NAN;
+  }
+  meterLayout();
 
   espIOTLibStart();
 
   ArduinoOTA.onStart([]() {
-    String type;
+    const char *type;
     if (ArduinoOTA.getCommand() == U_FLASH) {
       type = "sketch";
     } else { // U_FS
@@ -184,42 +473,53 @@ void setup() {
     }
 
     // NOTE: if updating FS this would be the place to unmount FS using FS.end()
-    Serial.println("Start updating " + type);
+    ESP_IOTLIB_LOGI("Start updating %s\n", type);
 
   });
   ArduinoOTA.onEnd([]() {       
-    Serial.println("\nEnd");
+    ESP_IOTLIB_LOGI("OTA End\n");
   });
   ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {    
-    Serial.printf("Progress: %u%%\r\n", (progress / (total / 100)));
+    ESP_IOTLIB_LOGD("Progress: %u%%\n", (progress / (total / 100)));
   });
   ArduinoOTA.onError([](ota_error_t error) {   
-    Serial.printf("Error[%u]: ", error);
+    const char *reason = "";
     if (error == OTA_AUTH_ERROR) {
-      Serial.println("Auth Failed");
+      reason = "Auth Failed";
     } else if (error == OTA_BEGIN_ERROR) {
-      Serial.println("Begin Failed");
+      reason = "Begin Failed";
     } else if (error == OTA_CONNECT_ERROR) {
-      Serial.println("Connect Failed");
+      reason = "Connect Failed";
     } else if (error == OTA_RECEIVE_ERROR) {
-      Serial.println("Receive Failed");
+      reason = "Receive Failed";
     } else if (error == OTA_END_ERROR) {
-      Serial.println("End Failed");
+      reason = "End Failed";
     }
+    ESP_IOTLIB_LOGE("OTA Error[%u]: %s\n", error, reason);
   });
 
-  mb.setup(&Serial0, PIN_RX, PIN_TX, 39); // Use pin39 as DE (unused)
-  mb.begin(1,115200,SERIAL_8E1); // Config Interface: Master, 115200 baud, 8E1
+  meterBus = mbBusAdd("rs485-1", &Serial0, PIN_RX, PIN_TX, PIN_DE, 115200, SERIAL_8E1);
+  // Before the second bus, so its device list cannot take the meter's unit
+  mbBusAddUnit(meterBus, METER_UNIT);
+  setupBus2();
+  mbBusStart(busResult);
+
+  mbGatewayBegin(mbBusReadUnit, METER_UNIT);
+
+  pollJob = espIOTLibSchedAdd(&sched, "poll", TIME_DIFFERENCE_STATE, ESP_IOTLIB_SCHED_SKIP, pollData, NULL);
+  burstBegin(MQTT_TOPIC_CAPTURE, mbBusReadUnit, &sched, METER_UNIT, BURST_ADDR, BURST_CHANNELS, burstTriggers, sizeof(burstTriggers)/sizeof(burstTrigger));
+  configSaved();
+  mqttCmdBegin(MQTT_TOPIC_CMD, MQTT_TOPIC_CMD_REPLY, mbBusReadUnit, &sched, pollJob, TIME_DIFFERENCE_STATE);
 }
 
 void loop() {
   espIOTLibLoop();
-  
+  // Results of the bus tasks
+  mbBusLoop();
+  mbGatewayLoop();
+  // Operator commands, their reads take turns with the bus tasks' transactions
+  mqttCmdLoop();
 
-  // Timer to publish pin state
-  if(millis() - oldTime > TIME_DIFFERENCE_STATE){
-    oldTime = millis();
-    
-    getData();
-  }
-}
\ No newline at end of file
+  // Run due jobs, then sleep until the next deadline (or a network event)
+  espIOTLibIdleUntil(espIOTLibSchedRun(&sched));
+}
@@ -0,0 +1,312 @@
+/**
+ * @file mbBus.cpp
+ * @author agent (agent@local)
+ * @brief Independent Modbus RTU buses, each polled by its own task and scheduler
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include "mbBus.h"
+#include "mbGateway.h"
+#include "regCache.h"
+#include "espIOTLib.h"
+#include "espIOTLibSched.h"
+#include "modbus-rtu.h"
+
+#include <atomic>
+
+// --- Defines ---
+#define MB_BUS_METRIC_NAME_LEN 64
+#define MB_BUS_METRIC_LABEL_LEN 32
+
+// --- Marcos ---
+
+// --- Typedefs ---
+typedef struct {
+    uint8_t bus;
+    uint8_t unit;
+    uint8_t fc;
+    uint16_t addr;
+    uint16_t count;
+} mbBusDevice;
+
+// One-shot read queued with mbBusSubmit()
+typedef struct {
+    uint8_t unit;
+    uint8_t fc;
+    uint16_t addr;
+    uint16_t count;
+    uint32_t tag;
+} mbBusRequest;
+
+typedef struct {
+    const char *name;
+    ModbusRTU rtu;
+    SemaphoreHandle_t lock;
+    QueueHandle_t requests;
+    espIOTLibSched sched;
+    TaskHandle_t task;
+    mbBusDevice devices[MB_BUS_MAX_DEVICES];
+    uint8_t deviceCount;
+    uint8_t rtuBuf[2 * MB_GATEWAY_MAX_REGS + 8];
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t timeouts;
+#ifdef ESP_IOTLIB_STATIC_ALLOC
+    StaticSemaphore_t lockStorage;
+    StaticQueue_t requestStorage;
+    uint8_t requestBuffer[MB_BUS_REQUEST_QUEUE_LEN * sizeof(mbBusRequest)];
+    StaticTask_t taskStorage;
+    StackType_t stack[MB_BUS_TASK_STACK];
+#endif
+} mbBus;
+
+// --- Private Vars ---
+static mbBus buses[MB_BUS_MAX];
+static uint8_t busCount = 0;
+static uint8_t unitBus[256];   // Bus index + 1 a unit id is attached to, 0 = none
+static QueueHandle_t resultQueue = NULL;
+static mbBusResultCB resultCallback = NULL;
+static std::atomic<uint32_t> statQueueDropped(0); // Bumped by all bus tasks
+static uint32_t statRequestsDropped = 0;
+#ifdef ESP_IOTLIB_STATIC_ALLOC
+static StaticQueue_t resultQueueStorage;
+static uint8_t resultQueueBuffer[MB_BUS_QUEUE_LEN * sizeof(mbBusResult)];
+#endif
+
+// --- Private Functions ---
+// Runs on the bus task: read and queue the result for the loop task
+void mbBusReadQueued(uint8_t index, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint32_t tag){
+    mbBusResult result;
+    result.bus = index;
+    result.unit = unit;
+    result.fc = fc;
+    result.addr = addr;
+    result.count = count;
+    result.exception = mbBusRead(index, unit, fc, addr, count, result.data);
+    result.stamp = millis();
+    result.tag = tag;
+    if(xQueueSend(resultQueue, &result, 0) != pdTRUE){
+        statQueueDropped++;
+        return;
+    }
+    espIOTLibWake();
+}
+
+void mbBusPoll(void *arg){
+    mbBusDevice *dev = (mbBusDevice *)arg;
+    mbBusReadQueued(dev->bus, dev->unit, dev->fc, dev->addr, dev->count, 0);
+}
+
+// Polls the devices of a bus, submitted reads go in between and also end the wait for the next poll
+void mbBusTask(void *arg){
+    mbBus *bus = (mbBus *)arg;
+    uint8_t index = bus - buses;
+    for(;;){
+        int32_t wait = (int32_t)(espIOTLibSchedRun(&bus->sched) - millis());
+        if(wait > MB_BUS_IDLE_MAX_MS){
+            wait = MB_BUS_IDLE_MAX_MS;
+        }
+        mbBusRequest req;
+        if(xQueueReceive(bus->requests, &req, pdMS_TO_TICKS(wait > 0 ? wait : 1)) == pdTRUE){
+            mbBusReadQueued(index, req.unit, req.fc, req.addr, req.count, req.tag);
+        }
+    }
+}
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+// Set up a bus on serial, returns its index or -1. dePin -1 if the transceiver switches itself
+int8_t mbBusAdd(const char *name, HardwareSerial *serial, int8_t rxPin, int8_t txPin, int8_t dePin, uint32_t baud, uint32_t config){
+    if(busCount >= MB_BUS_MAX || !serial){
+        return -1;
+    }
+    mbBus *bus = &buses[busCount];
+    bus->name = name;
+#ifdef ESP_IOTLIB_STATIC_ALLOC
+    bus->lock = xSemaphoreCreateMutexStatic(&bus->lockStorage);
+    bus->requests = xQueueCreateStatic(MB_BUS_REQUEST_QUEUE_LEN, sizeof(mbBusRequest), bus->requestBuffer, &bus->requestStorage);
+#else
+    bus->lock = xSemaphoreCreateMutex();
+    bus->requests = xQueueCreate(MB_BUS_REQUEST_QUEUE_LEN, sizeof(mbBusRequest));
+#endif
+    bus->rtu.setup(serial, rxPin, txPin, dePin);
+    bus->rtu.begin(1, baud, config); // Master
+    ESP_IOTLIB_LOGI("Modbus bus %s: %u baud, RX %d, TX %d\n", name, baud, rxPin, txPin);
+    return busCount++;
+}
+
+// Attach unit to a bus so reads by unit id go there. Returns -1 if the unit is on another bus
+int8_t mbBusAddUnit(uint8_t index, uint8_t unit){
+    if(index >= busCount){
+        return -1;
+    }
+    if(unitBus[unit] && unitBus[unit] != index + 1){
+        ESP_IOTLIB_LOGW("Modbus unit %u is already on bus %s\n", unit, mbBusName(unitBus[unit] - 1));
+        return -1;
+    }
+    unitBus[unit] = index + 1;
+    return 0;
+}
+
+// Poll count registers of unit every period ms on the bus task. Returns the device index on the bus or -1
+int8_t mbBusAddDevice(uint8_t index, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint32_t period){
+    if(index >= busCount || count == 0 || count > MB_BUS_MAX_REGS){
+        return -1;
+    }
+    if(mbBusAddUnit(index, unit) < 0){
+        return -1;
+    }
+    mbBus *bus = &buses[index];
+    if(bus->deviceCount >= MB_BUS_MAX_DEVICES){
+        return -1;
+    }
+    mbBusDevice *dev = &bus->devices[bus->deviceCount];
+    dev->bus = index;
+    dev->unit = unit;
+    dev->fc = fc;
+    dev->addr = addr;
+    dev->count = count;
+    if(espIOTLibSchedAdd(&bus->sched, bus->name, period, ESP_IOTLIB_SCHED_SKIP, mbBusPoll, dev) < 0){
+        return -1;
+    }
+    return bus->deviceCount++;
+}
+
+// Serial config for "8N1", "8E1", "8O1" or "8N2", 8E1 (Modbus default) otherwise
+uint32_t mbBusSerialConfig(const char *format){
+    if(strcmp(format, "8N1") == 0){
+        return SERIAL_8N1;
+    } else if(strcmp(format, "8O1") == 0){
+        return SERIAL_8O1;
+    } else if(strcmp(format, "8N2") == 0){
+        return SERIAL_8N2;
+    }
+    return SERIAL_8E1;
+}
+
+const char *mbBusName(uint8_t index){
+    return index < busCount ? buses[index].name : "?";
+}
+
+// Start a task for every bus, results of polls and submitted reads are passed to resultCB from mbBusLoop()
+void mbBusStart(mbBusResultCB resultCB){
+    resultCallback = resultCB;
+#ifdef ESP_IOTLIB_STATIC_ALLOC
+    resultQueue = xQueueCreateStatic(MB_BUS_QUEUE_LEN, sizeof(mbBusResult), resultQueueBuffer, &resultQueueStorage);
+#else
+    resultQueue = xQueueCreate(MB_BUS_QUEUE_LEN, sizeof(mbBusResult));
+#endif
+    for(uint8_t i = 0; i < busCount; i++){
+        mbBus *bus = &buses[i];
+#ifdef ESP_IOTLIB_STATIC_ALLOC
+        bus->task = xTaskCreateStatic(mbBusTask, bus->name, MB_BUS_TASK_STACK, bus, MB_BUS_TASK_PRIORITY, bus->stack, &bus->taskStorage);
+#else
+        xTaskCreate(mbBusTask, bus->name, MB_BUS_TASK_STACK, bus, MB_BUS_TASK_PRIORITY, &bus->task);
+#endif
+        ESP_IOTLIB_LOGI("Modbus bus %s polls %u devices\n", bus->name, bus->deviceCount);
+    }
+}
+
+// Queue a read of count registers for the task of a bus, the result arrives like a poll result and carries tag.
+// Returns 0, -1 on bad arguments or a full queue
+int8_t mbBusSubmit(uint8_t index, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint32_t tag){
+    if(index >= busCount || count == 0 || count > MB_BUS_MAX_REGS){
+        return -1;
+    }
+    mbBusRequest req = {unit, fc, addr, count, tag};
+    if(xQueueSend(buses[index].requests, &req, 0) != pdTRUE){
+        statRequestsDropped++;
+        return -1;
+    }
+    return 0;
+}
+
+// Read count registers on one bus, any task. Returns 0, the slave's exception code or a gateway exception code
+uint8_t mbBusRead(uint8_t index, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *data){
+    if(index >= busCount || count > MB_GATEWAY_MAX_REGS){
+        return MB_EX_GATEWAY_TARGET;
+    }
+    mbBus *bus = &buses[index];
+    uint8_t exception = 0;
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    uint16_t size = sizeof(bus->rtuBuf);
+    uint8_t error = bus->rtu.rs485_read(unit, fc, addr, count, bus->rtuBuf, &size);
+    bus->transactions++;
+    if(error != 0 || size != 2 * count){
+        ESP_IOTLIB_LOGW("Modbus %s read %u/0x%04X error: 0x%x\n", bus->name, unit, addr, error);
+        ESP_IOTLIB_LOGD("error msg: %s\n", bus->rtu.getLastError().c_str());
+        // rs485_read() returns the code of an exception response, pass it on. No answer at all counts as timeout
+        if(error >= MB_EX_ILLEGAL_FUNCTION && error <= MB_EX_GATEWAY_TARGET){
+            bus->errors++;
+            exception = error;
+        } else if(size == 0){
+            bus->timeouts++;
+            exception = MB_EX_GATEWAY_TARGET;
+        } else {
+            // CRC or length error
+            bus->errors++;
+            exception = MB_EX_SERVER_FAILURE;
+        }
+    } else {
+        memcpy(data, bus->rtuBuf, 2 * count);
+    }
+    xSemaphoreGive(bus->lock);
+    return exception;
+}
+
+// Read from the bus unit is attached to (the first bus if it is unknown) and fill the register cache. Loop task only
+uint8_t mbBusReadUnit(uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *data){
+    uint8_t index = unitBus[unit] ? unitBus[unit] - 1 : 0;
+    uint8_t exception = mbBusRead(index, unit, fc, addr, count, data);
+    if(!exception){
+        regCacheStore(unit, fc, addr, data, count);
+    }
+    return exception;
+}
+
+// Hand queued poll results to the result CB, call from the loop task
+void mbBusLoop(){
+    mbBusResult result;
+    while(resultQueue && xQueueReceive(resultQueue, &result, 0) == pdTRUE){
+        if(!result.exception){
+            regCacheStore(result.unit, result.fc, result.addr, result.data, result.count);
+        }
+        if(resultCallback){
+            resultCallback(&result);
+        }
+    }
+}
+
+void mbBusMetrics(const char *prefix){
+    char name[MB_BUS_METRIC_NAME_LEN];
+    char labels[MB_BUS_METRIC_LABEL_LEN];
+
+    snprintf(name, sizeof(name), "%smodbus_transactions_total", prefix);
+    espIOTLibMetricHeader(name, "counter", "Modbus RTU transactions");
+    for(uint8_t i = 0; i < busCount; i++){
+        snprintf(labels, sizeof(labels), "bus=\"%s\"", buses[i].name);
+        espIOTLibMetricValue(name, labels, buses[i].transactions);
+    }
+    snprintf(name, sizeof(name), "%smodbus_errors_total", prefix);
+    espIOTLibMetricHeader(name, "counter", "Modbus RTU transactions with error response");
+    for(uint8_t i = 0; i < busCount; i++){
+        snprintf(labels, sizeof(labels), "bus=\"%s\"", buses[i].name);
+        espIOTLibMetricValue(name, labels, buses[i].errors);
+    }
+    snprintf(name, sizeof(name), "%smodbus_timeouts_total", prefix);
+    espIOTLibMetricHeader(name, "counter", "Modbus RTU transactions without response");
+    for(uint8_t i = 0; i < busCount; i++){
+        snprintf(labels, sizeof(labels), "bus=\"%s\"", buses[i].name);
+        espIOTLibMetricValue(name, labels, buses[i].timeouts);
+    }
+    snprintf(name, sizeof(name), "%smodbus_results_dropped_total", prefix);
+    espIOTLibMetric(name, "counter", "Poll results dropped because the result queue was full", statQueueDropped.load());
+    snprintf(name, sizeof(name), "%smodbus_requests_dropped_total", prefix);
+    espIOTLibMetric(name, "counter", "Submitted reads dropped because the request queue of the bus was full", statRequestsDropped);
+}
@@ -0,0 +1,262 @@
+/**
+ * @file mbGateway.cpp
+ * @author agent (agent@local)
+ * @brief Modbus TCP server answering FC03 / FC04 reads from the register cache
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include "mbGateway.h"
+#include "regCache.h"
+#include "espIOTLib.h"
+
+#include <WiFi.h>
+
+// --- Defines ---
+// MBAP header (7) + function code (1) + byte count (1) + data
+#define MB_GATEWAY_FRAME_LEN (9 + 2 * MB_GATEWAY_MAX_REGS)
+#define MB_GATEWAY_MBAP_LEN 7
+#define MB_GATEWAY_METRIC_NAME_LEN 64
+
+// --- Marcos ---
+
+// --- Typedefs ---
+typedef struct {
+    WiFiClient client;
+    uint8_t rx[MB_GATEWAY_FRAME_LEN];
+    uint16_t rxLen;
+    uint32_t lastActivity;
+    bool active;
+} mbGatewayClient;
+
+typedef struct {
+    uint8_t client;
+    uint16_t tid;
+    uint8_t unit;   // As received, echoed in the response
+    uint8_t target; // Unit read from the cache / bus
+    uint8_t fc;
+    uint16_t addr;
+    uint16_t count;
+    uint8_t exception; // Set while parsing if the request is invalid
+    bool done;
+} mbGatewayRequest;
+
+// --- Private Vars ---
+static WiFiServer server(MB_GATEWAY_PORT);
+static bool serverStarted = false;
+static mbGatewayReadFn busRead = NULL;
+static uint8_t localUnit = 0;
+static uint32_t maxAge = MB_GATEWAY_MAX_AGE_MS;
+static mbGatewayClient clients[MB_GATEWAY_MAX_CLIENTS];
+static mbGatewayRequest pending[MB_GATEWAY_MAX_CLIENTS];
+static uint8_t pendingCount = 0;
+static uint8_t txBuf[MB_GATEWAY_FRAME_LEN];
+static uint8_t regBuf[2 * MB_GATEWAY_MAX_REGS];
+
+    // Statistics
+static uint32_t statRequests = 0;
+static uint32_t statCacheHits = 0;
+static uint32_t statCoalesced = 0;
+static uint32_t statBusReads = 0;
+static uint32_t statExceptions = 0;
+
+// --- Private Functions ---
+void mbGatewayAccept(){
+    WiFiClient client = server.available();
+    if(!client){
+        return;
+    }
+    for(uint8_t i = 0; i < MB_GATEWAY_MAX_CLIENTS; i++){
+        if(!clients[i].active){
+            clients[i].client = client;
+            clients[i].client.setNoDelay(true);
+            clients[i].rxLen = 0;
+            clients[i].lastActivity = millis();
+            clients[i].active = true;
+            ESP_IOTLIB_LOGI("Modbus TCP client %u connected\n", i);
+            return;
+        }
+    }
+    ESP_IOTLIB_LOGW("Modbus TCP: no free client slot\n");
+    client.stop();
+}
+
+void mbGatewayDrop(uint8_t index){
+    clients[index].client.stop();
+    clients[index].active = false;
+    ESP_IOTLIB_LOGI("Modbus TCP client %u disconnected\n", index);
+}
+
+// Read from one client, queue at most one complete request
+void mbGatewayReceive(uint8_t index){
+    mbGatewayClient *c = &clients[index];
+    if(!c->client.connected() || millis() - c->lastActivity > MB_GATEWAY_CLIENT_TIMEOUT_MS){
+        mbGatewayDrop(index);
+        return;
+    }
+    int available = c->client.available();
+    if(available > 0 && c->rxLen < MB_GATEWAY_FRAME_LEN){
+        uint16_t space = MB_GATEWAY_FRAME_LEN - c->rxLen;
+        c->rxLen += c->client.read(c->rx + c->rxLen, (size_t)available < space ? available : space);
+        c->lastActivity = millis();
+    }
+    if(c->rxLen < MB_GATEWAY_MBAP_LEN){
+        return;
+    }
+    uint16_t length = (c->rx[4] << 8) | c->rx[5];
+    if(length < 2 || length > MB_GATEWAY_FRAME_LEN - 6){
+        // Not Modbus TCP, resync is impossible
+        mbGatewayDrop(index);
+        return;
+    }
+    uint16_t frameLen = 6 + length;
+    if(c->rxLen < frameLen){
+        return;
+    }
+
+    uint16_t protocol = (c->rx[2] << 8) | c->rx[3];
+    if(protocol == 0){
+        mbGatewayRequest *req = &pending[pendingCount++];
+        req->client = index;
+        req->tid = (c->rx[0] << 8) | c->rx[1];
+        req->unit = c->rx[6];
+        req->target = req->unit == MB_GATEWAY_UNIT_THIS ? localUnit : req->unit;
+        req->fc = c->rx[7];
+        req->exception = 0;
+        req->done = false;
+        if(req->unit == 0){
+            // Broadcast, no RTU unit answers it
+            req->exception = MB_EX_GATEWAY_TARGET;
+        } else if(req->fc != 0x03 && req->fc != 0x04){
+            req->exception = MB_EX_ILLEGAL_FUNCTION;
+        } else if(length != 6){
+            req->exception = MB_EX_ILLEGAL_DATA_VALUE;
+        } else {
+            req->addr = (c->rx[8] << 8) | c->rx[9];
+            req->count = (c->rx[10] << 8) | c->rx[11];
+            if(req->count == 0 || req->count > MB_GATEWAY_MAX_REGS){
+                req->exception = MB_EX_ILLEGAL_DATA_VALUE;
+            }
+        }
+        statRequests++;
+    }
+    c->rxLen -= frameLen;
+    memmove(c->rx, c->rx + frameLen, c->rxLen);
+}
+
+void mbGatewayRespond(mbGatewayRequest *req, uint8_t exception, const uint8_t *data){
+    uint16_t len;
+    txBuf[0] = req->tid >> 8;
+    txBuf[1] = req->tid & 0xFF;
+    txBuf[2] = 0;
+    txBuf[3] = 0;
+    txBuf[6] = req->unit;
+    if(exception){
+        statExceptions++;
+        txBuf[7] = req->fc | 0x80;
+        txBuf[8] = exception;
+        len = 3;
+    } else {
+        txBuf[7] = req->fc;
+        txBuf[8] = 2 * req->count;
+        memcpy(txBuf + 9, data, 2 * req->count);
+        len = 3 + 2 * req->count;
+    }
+    txBuf[4] = len >> 8;
+    txBuf[5] = len & 0xFF;
+    clients[req->client].client.write(txBuf, 6 + len);
+    req->done = true;
+}
+
+// Answer all queued requests, each distinct range costs at most one RTU transaction
+void mbGatewayServe(){
+    for(uint8_t i = 0; i < pendingCount; i++){
+        mbGatewayRequest *req = &pending[i];
+        if(req->done){
+            continue;
+        }
+        if(req->exception){
+            mbGatewayRespond(req, req->exception, NULL);
+            continue;
+        }
+        if(regCacheLoad(req->target, req->fc, req->addr, req->count, maxAge, regBuf)){
+            statCacheHits++;
+            mbGatewayRespond(req, 0, regBuf);
+            continue;
+        }
+
+        statBusReads++;
+        uint8_t exception = busRead(req->target, req->fc, req->addr, req->count, regBuf);
+        mbGatewayRespond(req, exception, regBuf);
+        // Same range from other clients shares this transaction, also when it failed
+        for(uint8_t j = i + 1; j < pendingCount; j++){
+            mbGatewayRequest *other = &pending[j];
+            if(!other->done && !other->exception && other->target == req->target && other->fc == req->fc && other->addr == req->addr && other->count == req->count){
+                statCoalesced++;
+                mbGatewayRespond(other, exception, regBuf);
+            }
+        }
+    }
+    if(pendingCount){
+        espIOTLibMarkActivity();
+    }
+    pendingCount = 0;
+}
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+// Requests to unit MB_GATEWAY_UNIT_THIS are read from unit
+void mbGatewayBegin(mbGatewayReadFn readFn, uint8_t unit){
+    busRead = readFn;
+    localUnit = unit;
+    ESP_IOTLIB_LOGI("Modbus TCP gateway on port %d\n", MB_GATEWAY_PORT);
+}
+
+// Maximum age (ms) of cached registers before a read goes to the bus
+void mbGatewaySetMaxAge(uint32_t age){
+    maxAge = age;
+}
+
+void mbGatewayLoop(){
+    if(!busRead || !espIOTLibConnectedToWifi()){
+        return;
+    }
+    if(!serverStarted){
+        server.begin();
+        server.setNoDelay(true);
+        serverStarted = true;
+    }
+    mbGatewayAccept();
+    for(uint8_t i = 0; i < MB_GATEWAY_MAX_CLIENTS; i++){
+        if(clients[i].active){
+            mbGatewayReceive(i);
+        }
+    }
+    mbGatewayServe();
+}
+
+void mbGatewayMetrics(const char *prefix){
+    char name[MB_GATEWAY_METRIC_NAME_LEN];
+    uint8_t connected = 0;
+    for(uint8_t i = 0; i < MB_GATEWAY_MAX_CLIENTS; i++){
+        if(clients[i].active)
+            connected++;
+    }
+    snprintf(name, sizeof(name), "%sgateway_clients", prefix);
+    espIOTLibMetric(name, "gauge", "Connected Modbus TCP clients", connected);
+    snprintf(name, sizeof(name), "%sgateway_requests_total", prefix);
+    espIOTLibMetric(name, "counter", "Modbus TCP requests", statRequests);
+    snprintf(name, sizeof(name), "%sgateway_cache_hits_total", prefix);
+    espIOTLibMetric(name, "counter", "Modbus TCP requests served from the register cache", statCacheHits);
+    snprintf(name, sizeof(name), "%sgateway_coalesced_total", prefix);
+    espIOTLibMetric(name, "counter", "Modbus TCP requests that shared another request's RTU transaction", statCoalesced);
+    snprintf(name, sizeof(name), "%sgateway_bus_reads_total", prefix);
+    espIOTLibMetric(name, "counter", "RTU transactions issued for Modbus TCP requests", statBusReads);
+    snprintf(name, sizeof(name), "%sgateway_exceptions_total", prefix);
+    espIOTLibMetric(name, "counter", "Modbus TCP exception responses", statExceptions);
+}
@@ -0,0 +1,219 @@
+/**
+ * @file mqttCommands.cpp
+ * @author agent (agent@local)
+ * @brief On-demand register reads and poll rate changes via MQTT
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include "mqttCommands.h"
+#include "espIOTLib.h"
+
+// --- Defines ---
+#define MQTT_CMD_PAYLOAD_LEN 192
+#define MQTT_CMD_VALUE_LEN 24
+
+#define MQTT_CMD_READ 1
+#define MQTT_CMD_POLL 2
+
+// --- Marcos ---
+
+// --- Typedefs ---
+typedef struct {
+    char id[MQTT_CMD_ID_LEN];
+    uint8_t type;
+    uint8_t unit;
+    uint8_t fc;
+    uint16_t addr;
+    uint16_t count;
+    uint32_t period;   // ms
+    uint32_t duration; // s
+} mqttCmd;
+
+// --- Private Vars ---
+static const char *commandTopic = NULL;
+static const char *replyTopic = NULL;
+static mbGatewayReadFn busRead = NULL;
+static espIOTLibSched *pollSched = NULL;
+static int8_t pollJob = -1;
+static uint32_t pollPeriodDefault = 0;
+static bool fastPollActive = false;
+static uint32_t fastPollUntil = 0;
+
+static mqttCmd queue[MQTT_CMD_QUEUE_LEN];
+static uint8_t queueHead = 0;
+static uint8_t queueCount = 0;
+static uint8_t regBuf[2 * MQTT_CMD_MAX_REGS];
+
+// --- Private Functions ---
+// Value of "key" in a flat JSON object (quotes stripped), false if missing
+bool mqttCmdGet(const char *json, const char *key, char *value, size_t valueLen){
+    char pattern[MQTT_CMD_VALUE_LEN];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(json, pattern);
+    if(!p){
+        return false;
+    }
+    p += strlen(pattern);
+    while(*p == ' ' || *p == ':'){
+        p++;
+    }
+    bool quoted = (*p == '"');
+    if(quoted){
+        p++;
+    }
+    size_t len = 0;
+    while(*p && len < valueLen - 1){
+        if(quoted ? (*p == '"') : (*p == ',' || *p == '}' || *p == ' ')){
+            break;
+        }
+        value[len++] = *p++;
+    }
+    value[len] = '\0';
+    return true;
+}
+
+uint32_t mqttCmdGetNumber(const char *json, const char *key, uint32_t defaultValue){
+    char value[MQTT_CMD_VALUE_LEN];
+    if(!mqttCmdGet(json, key, value, sizeof(value)) || !value[0]){
+        return defaultValue;
+    }
+    return strtoul(value, NULL, 0);
+}
+
+void mqttCmdReply(const char *id, const char *format, ...){
+    char *msg = espIOTLibMQTTMsgAcquire();
+    if(!msg){
+        ESP_IOTLIB_LOGW("No buffer for reply to command %s\n", id);
+        return;
+    }
+    int len = snprintf(msg, ESP_IOTLIB_MQTT_BUFFER_SIZE, "{\"id\": \"%s\",", id);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg + len, ESP_IOTLIB_MQTT_BUFFER_SIZE - len, format, args);
+    va_end(args);
+    espIOTLibPublishStr(replyTopic, msg);
+    espIOTLibMQTTMsgRelease(msg);
+}
+
+// Runs inside the MQTT client loop: only parse and queue, publishing is not allowed here
+void mqttCmdMessage(MQTTClient *client, char topic[], char bytes[], int length){
+    char payload[MQTT_CMD_PAYLOAD_LEN];
+    char cmd[MQTT_CMD_VALUE_LEN];
+    // The client has one message callback for all subscriptions
+    if(!commandTopic || strcmp(topic, commandTopic) != 0){
+        return;
+    }
+    if(length <= 0 || length >= MQTT_CMD_PAYLOAD_LEN){
+        ESP_IOTLIB_LOGW("Command on %s too long\n", topic);
+        return;
+    }
+    memcpy(payload, bytes, length);
+    payload[length] = '\0';
+    if(queueCount >= MQTT_CMD_QUEUE_LEN){
+        ESP_IOTLIB_LOGW("Command queue full, dropped: %s\n", payload);
+        return;
+    }
+
+    mqttCmd *c = &queue[(queueHead + queueCount) % MQTT_CMD_QUEUE_LEN];
+    if(!mqttCmdGet(payload, "id", c->id, sizeof(c->id))){
+        c->id[0] = '\0';
+    }
+    if(!mqttCmdGet(payload, "cmd", cmd, sizeof(cmd))){
+        cmd[0] = '\0';
+    }
+    c->type = 0;
+    if(strcmp(cmd, "read") == 0){
+        c->type = MQTT_CMD_READ;
+        c->unit = mqttCmdGetNumber(payload, "unit", 1);
+        c->fc = mqttCmdGetNumber(payload, "fc", 0x03);
+        c->addr = mqttCmdGetNumber(payload, "addr", 0);
+        c->count = mqttCmdGetNumber(payload, "count", 1);
+    } else if(strcmp(cmd, "poll") == 0){
+        c->type = MQTT_CMD_POLL;
+        c->period = mqttCmdGetNumber(payload, "period", 0);
+        c->duration = mqttCmdGetNumber(payload, "duration", 60);
+    }
+    queueCount++;
+    ESP_IOTLIB_LOGD("Queued command: %s\n", payload);
+}
+
+void mqttCmdRead(mqttCmd *c){
+    if(c->count == 0 || c->count > MQTT_CMD_MAX_REGS || (c->fc != 0x03 && c->fc != 0x04)){
+        mqttCmdReply(c->id, "\"status\": \"error\",\"error\": \"invalid request\"}");
+        return;
+    }
+    uint8_t exception = busRead(c->unit, c->fc, c->addr, c->count, regBuf);
+    if(exception){
+        mqttCmdReply(c->id, "\"status\": \"error\",\"exception\": %u}", exception);
+        return;
+    }
+    char regs[7 * MQTT_CMD_MAX_REGS];
+    int len = 0;
+    for(uint16_t i = 0; i < c->count; i++){
+        len += snprintf(regs + len, sizeof(regs) - len, "%s%u", i ? "," : "", (regBuf[2 * i] << 8) | regBuf[2 * i + 1]);
+    }
+    mqttCmdReply(c->id, "\"status\": \"ok\",\"unit\": %u,\"fc\": %u,\"addr\": %u,\"regs\": [%s]}", c->unit, c->fc, c->addr, regs);
+}
+
+void mqttCmdPoll(mqttCmd *c){
+    if(c->period == 0){
+        fastPollActive = false;
+        espIOTLibSchedSetPeriod(pollSched, pollJob, pollPeriodDefault);
+        mqttCmdReply(c->id, "\"status\": \"ok\",\"period\": %u}", pollPeriodDefault);
+        return;
+    }
+    if(c->period < MQTT_CMD_MIN_PERIOD_MS){
+        c->period = MQTT_CMD_MIN_PERIOD_MS;
+    }
+    if(c->duration > MQTT_CMD_MAX_DURATION_S){
+        c->duration = MQTT_CMD_MAX_DURATION_S;
+    }
+    fastPollActive = true;
+    fastPollUntil = millis() + c->duration * 1000;
+    espIOTLibSchedSetPeriod(pollSched, pollJob, c->period);
+    // First sample right away
+    espIOTLibSchedTrigger(pollSched, pollJob);
+    ESP_IOTLIB_LOGI("Polling every %u ms for %u s\n", c->period, c->duration);
+    mqttCmdReply(c->id, "\"status\": \"ok\",\"period\": %u,\"duration\": %u}", c->period, c->duration);
+}
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+// Subscribe to cmdTopic, reads use readFn, poll commands change pollJob of sched (default period pollPeriod)
+void mqttCmdBegin(const char *cmdTopic, const char *reply, mbGatewayReadFn readFn, espIOTLibSched *sched, int8_t job, uint32_t pollPeriod){
+    commandTopic = cmdTopic;
+    replyTopic = reply;
+    busRead = readFn;
+    pollSched = sched;
+    pollJob = job;
+    pollPeriodDefault = pollPeriod;
+    espIOTLibAddMQTTCB(mqttCmdMessage);
+    espIOTLibSubscribeMQTT(cmdTopic);
+}
+
+// Execute queued commands from the loop task, reads wait for the bus lock the bus tasks take per transaction
+void mqttCmdLoop(){
+    if(fastPollActive && (int32_t)(millis() - fastPollUntil) >= 0){
+        fastPollActive = false;
+        espIOTLibSchedSetPeriod(pollSched, pollJob, pollPeriodDefault);
+        ESP_IOTLIB_LOGI("Fast polling ended\n");
+    }
+    while(queueCount){
+        mqttCmd *c = &queue[queueHead];
+        if(c->type == MQTT_CMD_READ){
+            mqttCmdRead(c);
+        } else if(c->type == MQTT_CMD_POLL){
+            mqttCmdPoll(c);
+        } else {
+            mqttCmdReply(c->id, "\"status\": \"error\",\"error\": \"unknown command\"}");
+        }
+        queueHead = (queueHead + 1) % MQTT_CMD_QUEUE_LEN;
+        queueCount--;
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ * @file regCache.cpp
+ * @author agent (agent@local)
+ * @brief Cache of raw Modbus registers read from the RTU side
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include "regCache.h"
+
+// --- Defines ---
+
+// --- Marcos ---
+
+// --- Typedefs ---
+typedef struct {
+    uint32_t stamp;  // millis() of the read
+    uint16_t addr;
+    uint16_t value;  // Register value as read from the bus
+    uint8_t unit;
+    uint8_t fc;
+    bool valid;
+} regCacheEntry;
+
+// --- Private Vars ---
+static regCacheEntry cache[REG_CACHE_SIZE];
+
+// --- Private Functions ---
+uint16_t regCacheHash(uint8_t unit, uint8_t fc, uint16_t addr){
+    return (addr ^ (unit * 31) ^ (fc << 7)) & (REG_CACHE_SIZE - 1);
+}
+
+regCacheEntry *regCacheFind(uint8_t unit, uint8_t fc, uint16_t addr){
+    uint16_t index = regCacheHash(unit, fc, addr);
+    for(uint8_t i = 0; i < REG_CACHE_PROBE; i++){
+        regCacheEntry *entry = &cache[(index + i) & (REG_CACHE_SIZE - 1)];
+        if(entry->valid && entry->addr == addr && entry->unit == unit && entry->fc == fc){
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Entry to (re)use for a register: the existing one, a free one or the oldest in the probe window
+regCacheEntry *regCacheSlot(uint8_t unit, uint8_t fc, uint16_t addr, uint32_t now){
+    uint16_t index = regCacheHash(unit, fc, addr);
+    regCacheEntry *oldest = NULL;
+    for(uint8_t i = 0; i < REG_CACHE_PROBE; i++){
+        regCacheEntry *entry = &cache[(index + i) & (REG_CACHE_SIZE - 1)];
+        if(!entry->valid || (entry->addr == addr && entry->unit == unit && entry->fc == fc)){
+            return entry;
+        }
+        if(!oldest || now - entry->stamp > now - oldest->stamp){
+            oldest = entry;
+        }
+    }
+    return oldest;
+}
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+// Store count registers starting at addr, data is big endian as on the wire
+void regCacheStore(uint8_t unit, uint8_t fc, uint16_t addr, const uint8_t *data, uint16_t count){
+    uint32_t now = millis();
+    for(uint16_t i = 0; i < count; i++){
+        regCacheEntry *entry = regCacheSlot(unit, fc, addr + i, now);
+        entry->stamp = now;
+        entry->addr = addr + i;
+        entry->value = (data[2 * i] << 8) | data[2 * i + 1];
+        entry->unit = unit;
+        entry->fc = fc;
+        entry->valid = true;
+    }
+}
+
+// Load count registers if all of them are cached and not older than maxAge ms
+bool regCacheLoad(uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint32_t maxAge, uint8_t *data){
+    uint32_t now = millis();
+    for(uint16_t i = 0; i < count; i++){
+        regCacheEntry *entry = regCacheFind(unit, fc, addr + i);
+        if(!entry || now - entry->stamp > maxAge){
+            return false;
+        }
+        data[2 * i] = entry->value >> 8;
+        data[2 * i + 1] = entry->value & 0xFF;
+    }
+    return true;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file regDecode.cpp
+ * @author agent (agent@local)
+ * @brief Decode typed values from a block of raw Modbus registers
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * Values are assembled with shifts and reinterpreted with memcpy, so the result does not
+ * depend on host endianness or alignment and there is no pointer type punning.
+ */
+
+// --- Includes ---
+#include "regDecode.h"
+
+#include <math.h>
+#include <string.h>
+
+// --- Defines ---
+
+// --- Marcos ---
+// 32 bit value from 4 wire bytes, first argument is the most significant byte
+#define REG_BE32(b0, b1, b2, b3) (((uint32_t)(b0) << 24) | ((uint32_t)(b1) << 16) | ((uint32_t)(b2) << 8) | (uint32_t)(b3))
+
+// --- Typedefs ---
+
+// --- Private Vars ---
+
+// --- Private Functions ---
+// Assemble regs registers into one value. Word order and byte order are independent swaps
+static inline uint64_t regDecodeRaw(const uint8_t *bytes, uint8_t order, uint8_t regs){
+    // regs is 1, 2 or 4, so reversing the word index is an xor
+    uint8_t wordMask = (order == REG_ORDER_CDAB || order == REG_ORDER_DCBA) ? regs - 1 : 0;
+    uint8_t hi = (order == REG_ORDER_BADC || order == REG_ORDER_DCBA) ? 1 : 0;
+    uint64_t raw = 0;
+    for(uint8_t r = 0; r < regs; r++){
+        const uint8_t *word = bytes + 2 * (r ^ wordMask);
+        raw = (raw << 16) | ((uint16_t)word[hi] << 8) | word[hi ^ 1];
+    }
+    return raw;
+}
+
+// --- Public Vars ---
+
+// --- Public Functions ---
+// Number of registers a value of type occupies
+uint8_t regDecodeWidth(uint8_t type){
+    switch(type){
+    case REG_TYPE_UINT16:
+    case REG_TYPE_INT16:
+        return 1;
+    case REG_TYPE_UINT64:
+        return 4;
+    default:
+        return 2;
+    }
+}
+
+// Decode count values described by desc from block (blockRegs registers, big endian as read). Values outside the block are NAN
+void regDecode(const uint8_t *block, uint16_t blockRegs, const regDesc *desc, uint16_t count, double *values){
+    for(uint16_t i = 0; i < count; i++){
+        const regDesc *d = &desc[i];
+        // Range check before forming the pointer, pointing beyond the block is undefined even without a read
+        if(d->offset + regDecodeWidth(d->type) > blockRegs){
+            values[i] = NAN;
+            continue;
+        }
+        const uint8_t *p = block + 2 * d->offset;
+        double value;
+        // Constant widths per case so the assembly loops unroll
+        switch(d->type){
+        case REG_TYPE_UINT16:
+        case REG_TYPE_INT16: {
+            uint16_t raw = regDecodeRaw(p, d->order, 1);
+            value = (d->type == REG_TYPE_INT16 && (raw & 0x8000)) ? (double)raw - 65536.0 : (double)raw;
+            break;
+        }
+        case REG_TYPE_UINT64:
+            value = (double)regDecodeRaw(p, d->order, 4);
+            break;
+        default: {
+            uint32_t raw = regDecodeRaw(p, d->order, 2);
+            if(d->type == REG_TYPE_FLOAT32){
+                float f;
+                memcpy(&f, &raw, sizeof(f));
+                value = f;
+            } else if(d->type == REG_TYPE_INT32 && (raw & 0x80000000UL)){
+                value = (double)raw - 4294967296.0;
+            } else {
+                value = raw;
+            }
+            break;
+        }
+        }
+        values[i] = value * d->scale;
+    }
+}
+
+// Decode count consecutive float32 values in the same order. Branch free inner loops for the common case
+void regDecodeFloat32(const uint8_t *block, uint16_t count, uint8_t order, float *values){
+    uint32_t bits;
+    switch(order){
+    case REG_ORDER_CDAB:
+        for(uint16_t i = 0; i < count; i++){
+            const uint8_t *b = block + 4 * i;
+            bits = REG_BE32(b[2], b[3], b[0], b[1]);
+            memcpy(&values[i], &bits, sizeof(bits));
+        }
+        break;
+    case REG_ORDER_BADC:
+        for(uint16_t i = 0; i < count; i++){
+            const uint8_t *b = block + 4 * i;
+            bits = REG_BE32(b[1], b[0], b[3], b[2]);
+            memcpy(&values[i], &bits, sizeof(bits));
+        }
+        break;
+    case REG_ORDER_DCBA:
+        for(uint16_t i = 0; i < count; i++){
+            const uint8_t *b = block + 4 * i;
+            bits = REG_BE32(b[3], b[2], b[1], b[0]);
+            memcpy(&values[i], &bits, sizeof(bits));
+        }
+        break;
+    default:
+        for(uint16_t i = 0; i < count; i++){
+            const uint8_t *b = block + 4 * i;
+            bits = REG_BE32(b[0], b[1], b[2], b[3]);
+            memcpy(&values[i], &bits, sizeof(bits));
+        }
+        break;
+    }
+}
+
+// Gather count float32 values at the register offsets (not range checked) of block, all in the same order
+void regDecodeFloat32Gather(const uint8_t *block, const uint16_t *offsets, uint16_t count, uint8_t order, float *values){
+    uint32_t bits;
+    switch(order){
+    case REG_ORDER_CDAB:
+        for(uint16_t i = 0; i < count; i++){
+            const uint8_t *b = block + 2 * offsets[i];
+            bits = REG_BE32(b[2], b[3], b[0], b[1]);
+            memcpy(&values[i], &bits, sizeof(bits));
+        }
+        break;
+    case REG_ORDER_BADC:
+        for(uint16_t i = 0; i < count; i++){
+            const uint8_t *b = block + 2 * offsets[i];
+            bits = REG_BE32(b[1], b[0], b[3], b[2]);
+            memcpy(&values[i], &bits, sizeof(bits));
+        }
+        break;
+    case REG_ORDER_DCBA:
+        for(uint16_t i = 0; i < count; i++){
+            const uint8_t *b = block + 2 * offsets[i];
+            bits = REG_BE32(b[3], b[2], b[1], b[0]);
+            memcpy(&values[i], &bits, sizeof(bits));
+        }
+        break;
+    default:
+        for(uint16_t i = 0; i < count; i++){
+            const uint8_t *b = block + 2 * offsets[i];
+            bits = REG_BE32(b[0], b[1], b[2], b[3]);
+            memcpy(&values[i], &bits, sizeof(bits));
+        }
+        break;
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ * @file Arduino.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for the Arduino-ESP32 core, just what the modules under test use
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+// --- Includes ---
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "freertosFake.h"
+
+// --- Defines ---
+#define SERIAL_8N1 0x800001c
+#define SERIAL_8N2 0x800003c
+#define SERIAL_8E1 0x800001e
+#define SERIAL_8O1 0x800001f
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+// --- Typedefs ---
+typedef int esp_err_t;
+
+class String {
+public:
+    String(const char *s = "") : str(s ? s : "") {}
+    const char *c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.size(); }
+    bool operator==(const char *s) const { return str == s; }
+    bool operator!=(const char *s) const { return str != s; }
+private:
+    std::string str;
+};
+
+class HardwareSerial {
+public:
+    explicit HardwareSerial(uint8_t port) : port(port) {}
+    const uint8_t port;
+};
+
+class IPAddress {
+public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr{a, b, c, d} {}
+    uint8_t operator[](int i) const { return addr[i]; }
+private:
+    uint8_t addr[4] = {0};
+};
+
+class EspClass {
+public:
+    void restart(){
+        restarts++;
+    }
+    uint32_t restarts = 0;
+};
+
+// --- Public Vars ---
+inline EspClass ESP;
+inline HardwareSerial Serial0(0);
+inline HardwareSerial Serial1(1);
+
+// --- Public Functions ---
+inline uint32_t micros(){
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline uint32_t millis(){
+    return micros() / 1000;
+}
+
+inline void delay(uint32_t ms){
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+#endif
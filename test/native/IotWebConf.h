@@ -0,0 +1,37 @@
+/**
+ * @file IotWebConf.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for IotWebConf, only the AP password used by the OTA endpoints
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef FAKE_IOTWEBCONF_H
+#define FAKE_IOTWEBCONF_H
+
+// --- Includes ---
+#include <Arduino.h>
+#include <WebServer.h>
+
+// --- Classes ---
+namespace iotwebconf {
+class PasswordParameter {
+public:
+    char *valueBuffer;
+};
+
+class IotWebConf {
+public:
+    PasswordParameter *getApPasswordParameter(){
+        return &apPassword;
+    }
+
+    char apPasswordValue[33] = "1234paul";
+    PasswordParameter apPassword = {apPasswordValue};
+};
+}
+using iotwebconf::IotWebConf;
+
+#endif
@@ -0,0 +1,17 @@
+/**
+ * @file MQTT.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for the 256dpi MQTT client, espIOTLib.h only passes it around
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef FAKE_MQTT_H
+#define FAKE_MQTT_H
+
+// --- Classes ---
+class MQTTClient;
+
+#endif
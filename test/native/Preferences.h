@@ -0,0 +1,52 @@
+/**
+ * @file Preferences.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for the Arduino-ESP32 Preferences (NVS), kept in fakeNvs across "reboots"
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef FAKE_PREFERENCES_H
+#define FAKE_PREFERENCES_H
+
+// --- Includes ---
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+// --- Public Vars ---
+// Namespace/key -> value
+inline std::map<std::string, uint32_t> fakeNvs;
+
+// --- Classes ---
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false){
+        space = name;
+        return true;
+    }
+
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0){
+        auto it = fakeNvs.find(space + "/" + key);
+        return it == fakeNvs.end() ? defaultValue : it->second;
+    }
+
+    size_t putUInt(const char *key, uint32_t value){
+        fakeNvs[space + "/" + key] = value;
+        return sizeof(value);
+    }
+
+    bool clear(){
+        for(auto it = fakeNvs.begin(); it != fakeNvs.end();){
+            it = it->first.compare(0, space.size() + 1, space + "/") == 0 ? fakeNvs.erase(it) : std::next(it);
+        }
+        return true;
+    }
+
+private:
+    std::string space;
+};
+
+#endif
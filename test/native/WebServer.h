@@ -0,0 +1,81 @@
+/**
+ * @file WebServer.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for the Arduino-ESP32 WebServer, tests call the registered handlers directly
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef FAKE_WEBSERVER_H
+#define FAKE_WEBSERVER_H
+
+// --- Includes ---
+#include <Arduino.h>
+#include <functional>
+#include <map>
+#include <string>
+
+// --- Defines ---
+#define HTTP_RAW_BUFLEN 1436
+
+// --- Typedefs ---
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST };
+enum HTTPRawStatus { RAW_START, RAW_WRITE, RAW_END, RAW_ABORTED };
+
+typedef struct {
+    HTTPRawStatus status;
+    size_t totalSize;
+    size_t currentSize;
+    uint8_t buf[HTTP_RAW_BUFLEN];
+} HTTPRaw;
+
+// --- Classes ---
+class WebServer {
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    explicit WebServer(int port) {}
+
+    void on(const char *uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn = nullptr){
+        handlers[uri] = fn;
+        uploads[uri] = ufn;
+    }
+
+    String arg(const char *name){
+        auto it = args.find(name);
+        return String(it == args.end() ? "" : it->second.c_str());
+    }
+
+    HTTPRaw &raw(){
+        return rawData;
+    }
+
+    bool authenticate(const char *user, const char *password){
+        return authorized;
+    }
+
+    void requestAuthentication(){
+        code = 401;
+        body = "";
+    }
+
+    void send(int status, const char *contentType, const char *content){
+        code = status;
+        body = content;
+    }
+
+    // Set by the test before calling a handler
+    std::map<std::string, std::string> args;
+    HTTPRaw rawData;
+    bool authorized = true;
+    // Registered handlers, upload handlers get the body
+    std::map<std::string, THandlerFunction> handlers;
+    std::map<std::string, THandlerFunction> uploads;
+    // Last response
+    int code = 0;
+    std::string body;
+};
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @file WiFi.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for the WiFi TCP server and client, connections are in-memory byte queues
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * fakeWiFiConnect() queues a connection for the next WiFiServer::available(). The test writes
+ * requests into its rx queue and reads the server's answers from its tx queue.
+ */
+#ifndef FAKE_WIFI_H
+#define FAKE_WIFI_H
+
+// --- Includes ---
+#include <Arduino.h>
+#include <deque>
+#include <memory>
+
+// --- Typedefs ---
+struct fakeWiFiConnection {
+    std::deque<uint8_t> rx; // Test to server
+    std::deque<uint8_t> tx; // Server to test
+    bool open = true;
+};
+
+// --- Public Vars ---
+inline std::deque<std::shared_ptr<fakeWiFiConnection>> fakeWiFiPending;
+
+// --- Classes ---
+class WiFiClient {
+public:
+    WiFiClient() {}
+    explicit WiFiClient(std::shared_ptr<fakeWiFiConnection> conn) : conn(conn) {}
+    explicit operator bool() const { return conn != nullptr; }
+
+    void setNoDelay(bool noDelay){
+    }
+
+    void stop(){
+        if(conn){
+            conn->open = false;
+        }
+        conn = nullptr;
+    }
+
+    uint8_t connected(){
+        return conn && conn->open;
+    }
+
+    int available(){
+        return conn ? conn->rx.size() : 0;
+    }
+
+    int read(uint8_t *buf, size_t size){
+        size_t n = 0;
+        while(conn && n < size && !conn->rx.empty()){
+            buf[n++] = conn->rx.front();
+            conn->rx.pop_front();
+        }
+        return n;
+    }
+
+    size_t write(const uint8_t *buf, size_t size){
+        if(!connected()){
+            return 0;
+        }
+        conn->tx.insert(conn->tx.end(), buf, buf + size);
+        return size;
+    }
+
+private:
+    std::shared_ptr<fakeWiFiConnection> conn;
+};
+
+class WiFiServer {
+public:
+    explicit WiFiServer(uint16_t port) {}
+
+    void begin(){
+    }
+
+    void setNoDelay(bool noDelay){
+    }
+
+    WiFiClient available(){
+        if(fakeWiFiPending.empty()){
+            return WiFiClient();
+        }
+        WiFiClient client(fakeWiFiPending.front());
+        fakeWiFiPending.pop_front();
+        return client;
+    }
+};
+
+// --- Public Functions ---
+inline std::shared_ptr<fakeWiFiConnection> fakeWiFiConnect(){
+    auto conn = std::make_shared<fakeWiFiConnection>();
+    fakeWiFiPending.push_back(conn);
+    return conn;
+}
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * @file espIOTLibFake.h
+ * @author agent (agent@local)
+ * @brief Host definitions of the espIOTLib calls the modules under test make, include once per test
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * Log lines go to stdout, metrics are collected by name so tests can check them. The web server
+ * and IotWebConf are the fakes from this directory.
+ */
+#ifndef ESPIOTLIB_FAKE_H
+#define ESPIOTLIB_FAKE_H
+
+// --- Includes ---
+#include "espIOTLib.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <stdarg.h>
+
+// --- Public Vars ---
+volatile uint8_t espIOTLibLogLevel = ESP_IOTLIB_LOG_WARN;
+WebServer fakeWebServer(80);
+IotWebConf fakeIotWebConf;
+std::atomic<uint32_t> fakeWakeCount(0);
+bool fakeWiFiConnected = true;
+// Last value per metric name and labels
+std::map<std::string, double> fakeMetrics;
+
+// --- Public Functions ---
+void espIOTLibLogf(uint8_t level, const char *format, ...){
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+bool espIOTLibConnectedToWifi(){
+    return fakeWiFiConnected;
+}
+
+WebServer *espIOTLibGetWebServer(){
+    return &fakeWebServer;
+}
+
+IotWebConf *espIOTLibGetIotWebConf(){
+    return &fakeIotWebConf;
+}
+
+void espIOTLibWake(){
+    fakeWakeCount++;
+}
+
+void espIOTLibMarkActivity(){
+}
+
+void espIOTLibMetricHeader(const char *name, const char *type, const char *help){
+}
+
+void espIOTLibMetricValue(const char *name, const char *labels, double value){
+    fakeMetrics[std::string(name) + "{" + (labels ? labels : "") + "}"] = value;
+}
+
+void espIOTLibMetric(const char *name, const char *type, const char *help, double value){
+    espIOTLibMetricValue(name, NULL, value);
+}
+
+#endif
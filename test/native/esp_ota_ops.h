@@ -0,0 +1,31 @@
+/**
+ * @file esp_ota_ops.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for the ESP-IDF OTA calls, the test picks the update partition
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+#ifndef FAKE_ESP_OTA_OPS_H
+#define FAKE_ESP_OTA_OPS_H
+
+// --- Includes ---
+#include "esp_partition.h"
+
+// --- Public Vars ---
+inline const esp_partition_t *fakeNextPartition = nullptr;
+inline const esp_partition_t *fakeBootPartition = nullptr;
+
+// --- Public Functions ---
+inline const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start){
+    return fakeNextPartition;
+}
+
+inline esp_err_t esp_ota_set_boot_partition(const esp_partition_t *part){
+    fakeBootPartition = part;
+    return ESP_OK;
+}
+
+#endif
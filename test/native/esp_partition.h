@@ -0,0 +1,64 @@
+/**
+ * @file esp_partition.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for ESP-IDF partitions, backed by one flash image in memory
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * Writes only clear bits like NOR flash does, erases must be sector aligned.
+ */
+#ifndef FAKE_ESP_PARTITION_H
+#define FAKE_ESP_PARTITION_H
+
+// --- Includes ---
+#include <Arduino.h>
+#include <vector>
+
+// --- Defines ---
+#define FAKE_FLASH_SIZE (4 * 1024 * 1024)
+#define FAKE_FLASH_SECTOR 4096
+
+// --- Typedefs ---
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+// --- Public Vars ---
+inline std::vector<uint8_t> fakeFlash(FAKE_FLASH_SIZE, 0xFF);
+
+// --- Public Functions ---
+inline bool fakeFlashRange(const esp_partition_t *part, size_t offset, size_t size){
+    return offset + size <= part->size && part->address + offset + size <= fakeFlash.size();
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size){
+    if(!fakeFlashRange(part, offset, size)){
+        return ESP_FAIL;
+    }
+    memcpy(dst, &fakeFlash[part->address + offset], size);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size){
+    if(!fakeFlashRange(part, offset, size)){
+        return ESP_FAIL;
+    }
+    for(size_t i = 0; i < size; i++){
+        fakeFlash[part->address + offset + i] &= ((const uint8_t *)src)[i];
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size){
+    if(!fakeFlashRange(part, offset, size) || offset % FAKE_FLASH_SECTOR || size % FAKE_FLASH_SECTOR){
+        return ESP_FAIL;
+    }
+    memset(&fakeFlash[part->address + offset], 0xFF, size);
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * @file freertosFake.h
+ * @author agent (agent@local)
+ * @brief FreeRTOS tasks, queues and mutexes on std::thread for host tests, 1 tick = 1 ms
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * Tasks run forever on the device. Here fakeRTOSStop() ends them: blocking calls inside a task
+ * throw once it was called, the task's thread catches that and is joined.
+ */
+#ifndef FREERTOS_FAKE_H
+#define FREERTOS_FAKE_H
+
+// --- Includes ---
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --- Defines ---
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+// Blocking calls wake up this often to notice fakeRTOSStop()
+#define FAKE_RTOS_SLICE_MS 5
+
+// --- Typedefs ---
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void *);
+
+struct fakeQueue {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+typedef fakeQueue *QueueHandle_t;
+
+struct fakeMutex {
+    std::mutex lock;
+};
+typedef fakeMutex *SemaphoreHandle_t;
+typedef std::thread::id *TaskHandle_t;
+
+// Thrown inside tasks once fakeRTOSStop() was called
+struct fakeRTOSStopped {};
+
+// --- Private Vars ---
+inline std::atomic<bool> fakeRTOSStopping(false);
+inline std::mutex fakeRTOSTasksLock;
+inline std::vector<std::thread> fakeRTOSTasks;
+inline thread_local bool fakeRTOSInTask = false;
+
+// --- Private Functions ---
+inline bool fakeRTOSShouldStop(){
+    return fakeRTOSInTask && fakeRTOSStopping;
+}
+
+// --- Public Functions ---
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *task){
+    std::lock_guard<std::mutex> guard(fakeRTOSTasksLock);
+    fakeRTOSTasks.emplace_back([fn, arg](){
+        fakeRTOSInTask = true;
+        try {
+            fn(arg);
+        } catch(const fakeRTOSStopped &){
+        }
+    });
+    if(task){
+        *task = nullptr;
+    }
+    return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks){
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+    while(std::chrono::steady_clock::now() < until){
+        if(fakeRTOSShouldStop()){
+            throw fakeRTOSStopped();
+        }
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(until - std::chrono::steady_clock::now(), std::chrono::milliseconds(FAKE_RTOS_SLICE_MS)));
+    }
+}
+
+// End all tasks, the objects they used stay valid
+inline void fakeRTOSStop(){
+    fakeRTOSStopping = true;
+    std::lock_guard<std::mutex> guard(fakeRTOSTasksLock);
+    for(std::thread &task : fakeRTOSTasks){
+        task.join();
+    }
+    fakeRTOSTasks.clear();
+    fakeRTOSStopping = false;
+}
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize){
+    QueueHandle_t queue = new fakeQueue;
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+// Only non-blocking sends, like all callers under test
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait){
+    std::lock_guard<std::mutex> guard(queue->lock);
+    if(queue->items.size() >= queue->length){
+        return pdFALSE;
+    }
+    const uint8_t *bytes = (const uint8_t *)item;
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->changed.notify_one();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait){
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(wait);
+    std::unique_lock<std::mutex> guard(queue->lock);
+    while(queue->items.empty()){
+        if(fakeRTOSShouldStop()){
+            throw fakeRTOSStopped();
+        }
+        auto now = std::chrono::steady_clock::now();
+        if(wait != portMAX_DELAY && now >= until){
+            return pdFALSE;
+        }
+        auto slice = std::chrono::milliseconds(FAKE_RTOS_SLICE_MS);
+        queue->changed.wait_for(guard, wait == portMAX_DELAY ? slice : std::min<std::chrono::steady_clock::duration>(until - now, slice));
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex(){
+    return new fakeMutex;
+}
+
+// Only waits forever, like all callers under test
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait){
+    mutex->lock.lock();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex){
+    mutex->lock.unlock();
+    return pdTRUE;
+}
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @file modbus-rtu.h
+ * @author agent (agent@local)
+ * @brief Host stand-in for the ModbusRTU master, talks to simulated slaves
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * A transaction blocks for the time request and response take on the wire at the configured
+ * baud rate, then fakeModbusSlave answers it. Overlapping transactions on one instance are
+ * counted, they mean two tasks drove the same UART.
+ */
+#ifndef FAKE_MODBUS_RTU_H
+#define FAKE_MODBUS_RTU_H
+
+// --- Includes ---
+#include <Arduino.h>
+#include <atomic>
+
+// --- Defines ---
+// Request frame and response frame without data, bytes
+#define FAKE_MODBUS_REQUEST_LEN 8
+#define FAKE_MODBUS_RESPONSE_LEN 5
+// rs485_read() errors that are no exception code
+#define FAKE_MODBUS_ERR_TIMEOUT 0xE0
+#define FAKE_MODBUS_ERR_CRC 0xE2
+
+// --- Typedefs ---
+// Answer a read: fill buf / size and return 0, an exception code or a FAKE_MODBUS_ERR_*
+typedef uint8_t (*fakeModbusSlaveFn)(uint8_t port, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *buf, uint16_t *size);
+
+// --- Public Vars ---
+inline fakeModbusSlaveFn fakeModbusSlave = nullptr;
+// Transactions in progress on all instances, and the most seen at once
+inline std::atomic<int> fakeModbusActive(0);
+inline std::atomic<int> fakeModbusMaxActive(0);
+
+// --- Classes ---
+class ModbusRTU {
+public:
+    void setup(HardwareSerial *serial, int8_t rxPin, int8_t txPin, int8_t dePin){
+        port = serial->port;
+    }
+
+    void begin(uint8_t mode, uint32_t baudrate, uint32_t config){
+        baud = baudrate;
+    }
+
+    uint8_t rs485_read(uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *buf, uint16_t *size){
+        if(busy.fetch_add(1)){
+            overlaps++;
+        }
+        int active = ++fakeModbusActive;
+        int seen = fakeModbusMaxActive;
+        while(active > seen && !fakeModbusMaxActive.compare_exchange_weak(seen, active)){
+        }
+        // 11 bits per character in all supported formats
+        uint32_t bytes = FAKE_MODBUS_REQUEST_LEN + FAKE_MODBUS_RESPONSE_LEN + 2 * count;
+        std::this_thread::sleep_for(std::chrono::microseconds(bytes * 11 * 1000000ULL / baud));
+        uint8_t error = FAKE_MODBUS_ERR_TIMEOUT;
+        *size = 0;
+        if(fakeModbusSlave){
+            error = fakeModbusSlave(port, unit, fc, addr, count, buf, size);
+        }
+        fakeModbusActive--;
+        busy--;
+        return error;
+    }
+
+    String getLastError(){
+        return String("simulated");
+    }
+
+    std::atomic<uint32_t> overlaps{0};
+
+private:
+    uint8_t port = 0;
+    uint32_t baud = 9600;
+    std::atomic<int> busy{0};
+};
+
+#endif
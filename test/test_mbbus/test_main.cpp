@@ -0,0 +1,217 @@
+/**
+ * @file test_main.cpp
+ * @author agent (agent@local)
+ * @brief Host tests of two simulated Modbus buses: unit routing, error mapping and both bus tasks
+ *        running transactions at the same time
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * The bus module keeps its buses for the whole run, so the buses are set up once and the tests run
+ * in order: the blocking reads first, then the bus tasks are started.
+ */
+
+// --- Includes ---
+#include <unity.h>
+
+#include "espIOTLibFake.h"
+#include "espIOTLibSched.cpp"
+#include "regCache.cpp"
+#include "mbBus.cpp"
+
+#include <vector>
+
+// --- Defines ---
+#define BAUD 19200
+#define METER_UNIT 0x01
+#define DEVICE_UNIT 0x02
+#define SILENT_UNIT 0x77
+// Registers per read in the parallel test, 16.6 ms on the wire at BAUD
+#define READ_REGS 8
+#define RUN_MS 1500
+// Reads the loop keeps submitted to the meter bus
+#define SUBMIT_AHEAD 4
+
+#define ADDR_EXCEPTION 0x9000
+#define ADDR_CRC 0x9100
+#define ADDR_SHORT 0x9200
+
+// --- Private Vars ---
+static int8_t meterBus;
+static int8_t deviceBus;
+static std::vector<mbBusResult> results;
+
+// --- Private Functions ---
+// Register value that tells which port and unit answered
+static uint16_t slaveValue(uint8_t port, uint8_t unit, uint16_t reg){
+    return (port << 12) | ((unit & 0x0F) << 8) | (reg & 0xFF);
+}
+
+// Every unit except SILENT_UNIT answers on both ports, like two meters with the factory unit id would
+static uint8_t slave(uint8_t port, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *buf, uint16_t *size){
+    if(unit == SILENT_UNIT){
+        return FAKE_MODBUS_ERR_TIMEOUT;
+    }
+    switch(addr){
+    case ADDR_EXCEPTION:
+        return MB_EX_ILLEGAL_DATA_ADDRESS;
+    case ADDR_CRC:
+        *size = 3;
+        return FAKE_MODBUS_ERR_CRC;
+    case ADDR_SHORT:
+        count--;
+        break;
+    }
+    for(uint16_t i = 0; i < count; i++){
+        uint16_t value = slaveValue(port, unit, addr + i);
+        buf[2 * i] = value >> 8;
+        buf[2 * i + 1] = value & 0xFF;
+    }
+    *size = 2 * count;
+    return 0;
+}
+
+static bool fromPort(const uint8_t *data, uint8_t port, uint8_t unit, uint16_t addr, uint16_t count){
+    for(uint16_t i = 0; i < count; i++){
+        if(((data[2 * i] << 8) | data[2 * i + 1]) != slaveValue(port, unit, addr + i)){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void collect(const mbBusResult *result){
+    results.push_back(*result);
+}
+
+// Milliseconds one read of READ_REGS takes on the wire
+static double readMs(){
+    return (FAKE_MODBUS_REQUEST_LEN + FAKE_MODBUS_RESPONSE_LEN + 2 * READ_REGS) * 11 * 1000.0 / BAUD;
+}
+
+// --- Tests ---
+void setUp(void){
+}
+
+void tearDown(void){
+}
+
+void test_unit_ids_unique_across_buses(void){
+    TEST_ASSERT_EQUAL_INT(0, mbBusAddUnit(meterBus, METER_UNIT));
+    // Same bus again is fine, another bus is not
+    TEST_ASSERT_EQUAL_INT(0, mbBusAddUnit(meterBus, METER_UNIT));
+    TEST_ASSERT_EQUAL_INT(-1, mbBusAddDevice(deviceBus, METER_UNIT, 0x03, 0x0000, READ_REGS, 1));
+    TEST_ASSERT_EQUAL_INT(-1, mbBusAddUnit(MB_BUS_MAX, DEVICE_UNIT));
+    // Polled as fast as the bus allows
+    TEST_ASSERT_TRUE(mbBusAddDevice(deviceBus, DEVICE_UNIT, 0x03, 0x0100, READ_REGS, 1) >= 0);
+    TEST_ASSERT_EQUAL_INT(-1, mbBusAddUnit(meterBus, DEVICE_UNIT));
+}
+
+void test_read_unit_goes_to_its_bus(void){
+    uint8_t data[2 * READ_REGS];
+    TEST_ASSERT_EQUAL_UINT8(0, mbBusReadUnit(METER_UNIT, 0x03, 0x5002, READ_REGS, data));
+    TEST_ASSERT_TRUE(fromPort(data, 0, METER_UNIT, 0x5002, READ_REGS));
+    TEST_ASSERT_EQUAL_UINT8(0, mbBusReadUnit(DEVICE_UNIT, 0x03, 0x0100, READ_REGS, data));
+    TEST_ASSERT_TRUE(fromPort(data, 1, DEVICE_UNIT, 0x0100, READ_REGS));
+    // Unknown units go to the first bus
+    TEST_ASSERT_EQUAL_UINT8(0, mbBusReadUnit(0x05, 0x03, 0x0000, 1, data));
+    TEST_ASSERT_TRUE(fromPort(data, 0, 0x05, 0x0000, 1));
+    // Successful reads fill the register cache
+    TEST_ASSERT_TRUE(regCacheLoad(DEVICE_UNIT, 0x03, 0x0100, READ_REGS, 1000, data));
+    TEST_ASSERT_TRUE(fromPort(data, 1, DEVICE_UNIT, 0x0100, READ_REGS));
+}
+
+void test_errors_map_to_exceptions(void){
+    uint8_t data[2 * READ_REGS];
+    uint32_t errors = buses[meterBus].errors;
+    uint32_t timeouts = buses[meterBus].timeouts;
+    // The slave's exception code is passed on
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_ILLEGAL_DATA_ADDRESS, mbBusReadUnit(METER_UNIT, 0x03, ADDR_EXCEPTION, 2, data));
+    // Broken frames are a server failure, no answer is a gateway target failure
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_SERVER_FAILURE, mbBusReadUnit(METER_UNIT, 0x03, ADDR_CRC, 2, data));
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_SERVER_FAILURE, mbBusReadUnit(METER_UNIT, 0x03, ADDR_SHORT, 2, data));
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_GATEWAY_TARGET, mbBusRead(meterBus, SILENT_UNIT, 0x03, 0x0000, 2, data));
+    TEST_ASSERT_EQUAL_UINT32(errors + 3, buses[meterBus].errors);
+    TEST_ASSERT_EQUAL_UINT32(timeouts + 1, buses[meterBus].timeouts);
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_GATEWAY_TARGET, mbBusRead(MB_BUS_MAX, METER_UNIT, 0x03, 0x0000, 2, data));
+}
+
+void test_submit_rejects_bad_reads(void){
+    TEST_ASSERT_EQUAL_INT(-1, mbBusSubmit(MB_BUS_MAX, METER_UNIT, 0x03, 0x0000, 2, 1));
+    TEST_ASSERT_EQUAL_INT(-1, mbBusSubmit(meterBus, METER_UNIT, 0x03, 0x0000, 0, 1));
+    TEST_ASSERT_EQUAL_INT(-1, mbBusSubmit(meterBus, METER_UNIT, 0x03, 0x0000, MB_BUS_MAX_REGS + 1, 1));
+}
+
+// The meter bus only runs submitted reads (like main.cpp's meter poll), the other bus polls its device
+void test_two_buses_in_parallel(void){
+    results.clear();
+    fakeModbusMaxActive = 0;
+    mbBusStart(collect);
+
+    uint32_t submitted = 0;
+    uint32_t start = millis();
+    while(millis() - start < RUN_MS){
+        uint32_t meterResults = 0;
+        for(const mbBusResult &result : results){
+            meterResults += (result.bus == meterBus);
+        }
+        while(submitted - meterResults < SUBMIT_AHEAD){
+            submitted++;
+            TEST_ASSERT_EQUAL_INT(0, mbBusSubmit(meterBus, METER_UNIT, 0x03, 0x5002, READ_REGS, submitted));
+        }
+        mbBusLoop();
+        delay(1);
+    }
+    fakeRTOSStop();
+    mbBusLoop();
+    // Reads still queued run until the tasks end
+    uint32_t elapsed = millis() - start;
+
+    uint32_t count[2] = {0, 0};
+    for(const mbBusResult &result : results){
+        TEST_ASSERT_EQUAL_UINT8(0, result.exception);
+        TEST_ASSERT_EQUAL_UINT16(READ_REGS, result.count);
+        if(result.bus == meterBus){
+            TEST_ASSERT_EQUAL_UINT8(METER_UNIT, result.unit);
+            TEST_ASSERT_TRUE(fromPort(result.data, 0, METER_UNIT, 0x5002, READ_REGS));
+            // Submitted reads come back in order with their tag
+            TEST_ASSERT_EQUAL_UINT32(count[meterBus] + 1, result.tag);
+        } else {
+            TEST_ASSERT_EQUAL_INT(deviceBus, result.bus);
+            TEST_ASSERT_EQUAL_UINT8(DEVICE_UNIT, result.unit);
+            TEST_ASSERT_EQUAL_UINT32(0, result.tag);
+            TEST_ASSERT_TRUE(fromPort(result.data, 1, DEVICE_UNIT, 0x0100, READ_REGS));
+        }
+        count[result.bus]++;
+    }
+
+    // Each bus close to what its wire allows, together well beyond one bus
+    const double perBus = elapsed / readMs();
+    char msg[96];
+    snprintf(msg, sizeof(msg), "reads in %u ms: %u + %u, one bus at most %.0f", elapsed, count[0], count[1], perBus);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(count[meterBus] >= 0.75 * perBus);
+    TEST_ASSERT_TRUE(count[deviceBus] >= 0.75 * perBus);
+    TEST_ASSERT_TRUE(count[0] + count[1] >= 1.6 * perBus);
+    TEST_ASSERT_EQUAL_INT(2, fakeModbusMaxActive.load());
+    // Never two transactions on one UART
+    TEST_ASSERT_EQUAL_UINT32(0, buses[meterBus].rtu.overlaps.load());
+    TEST_ASSERT_EQUAL_UINT32(0, buses[deviceBus].rtu.overlaps.load());
+    TEST_ASSERT_EQUAL_UINT32(0, statQueueDropped.load());
+    TEST_ASSERT_TRUE(fakeWakeCount > 0);
+}
+
+int main(int argc, char **argv){
+    fakeModbusSlave = slave;
+    meterBus = mbBusAdd("rs485-1", &Serial0, 0, 0, -1, BAUD, SERIAL_8E1);
+    deviceBus = mbBusAdd("rs485-2", &Serial1, 0, 0, -1, BAUD, SERIAL_8N1);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_unit_ids_unique_across_buses);
+    RUN_TEST(test_read_unit_goes_to_its_bus);
+    RUN_TEST(test_errors_map_to_exceptions);
+    RUN_TEST(test_submit_rejects_bad_reads);
+    RUN_TEST(test_two_buses_in_parallel);
+    return UNITY_END();
+}
@@ -0,0 +1,203 @@
+/**
+ * @file test_main.cpp
+ * @author agent (agent@local)
+ * @brief Host tests of the Modbus TCP gateway: request checks, unit mapping, cache hits and
+ *        requests sharing one RTU transaction
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include <unity.h>
+
+#include "espIOTLibFake.h"
+#include "regCache.cpp"
+#include "mbGateway.cpp"
+
+#include <vector>
+
+// --- Defines ---
+#define METER_UNIT 0x01
+#define OTHER_UNIT 0x02
+
+// --- Typedefs ---
+typedef struct {
+    uint8_t unit;
+    uint8_t fc;
+    uint16_t addr;
+    uint16_t count;
+} busCall;
+
+// --- Private Vars ---
+static std::vector<busCall> busCalls;
+static std::vector<std::shared_ptr<fakeWiFiConnection>> conns;
+
+// --- Private Functions ---
+// Register value that tells which unit answered
+static uint16_t unitValue(uint8_t unit, uint16_t reg){
+    return (unit << 8) | (reg & 0xFF);
+}
+
+static uint8_t rtuRead(uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count, uint8_t *data){
+    busCalls.push_back({unit, fc, addr, count});
+    for(uint16_t i = 0; i < count; i++){
+        data[2 * i] = unitValue(unit, addr + i) >> 8;
+        data[2 * i + 1] = unitValue(unit, addr + i) & 0xFF;
+    }
+    return 0;
+}
+
+static std::shared_ptr<fakeWiFiConnection> connect(){
+    auto conn = fakeWiFiConnect();
+    conns.push_back(conn);
+    mbGatewayLoop();
+    return conn;
+}
+
+static void request(std::shared_ptr<fakeWiFiConnection> conn, uint16_t tid, uint8_t unit, uint8_t fc, uint16_t addr, uint16_t count){
+    const uint8_t frame[] = {(uint8_t)(tid >> 8), (uint8_t)tid, 0, 0, 0, 6, unit, fc,
+                             (uint8_t)(addr >> 8), (uint8_t)addr, (uint8_t)(count >> 8), (uint8_t)count};
+    conn->rx.insert(conn->rx.end(), frame, frame + sizeof(frame));
+}
+
+// Take one response off the connection, returns its exception code or 0
+static uint8_t response(std::shared_ptr<fakeWiFiConnection> conn, uint16_t tid, uint8_t unit, uint8_t fc, std::vector<uint16_t> *regs){
+    TEST_ASSERT_TRUE(conn->tx.size() >= 9);
+    uint8_t head[9];
+    for(uint8_t i = 0; i < 9; i++){
+        head[i] = conn->tx.front();
+        conn->tx.pop_front();
+    }
+    TEST_ASSERT_EQUAL_UINT16(tid, (head[0] << 8) | head[1]);
+    TEST_ASSERT_EQUAL_UINT8(unit, head[6]);
+    if(head[7] & 0x80){
+        TEST_ASSERT_EQUAL_UINT8(fc | 0x80, head[7]);
+        TEST_ASSERT_EQUAL_UINT16(3, (head[4] << 8) | head[5]);
+        return head[8];
+    }
+    TEST_ASSERT_EQUAL_UINT8(fc, head[7]);
+    TEST_ASSERT_EQUAL_UINT16(3 + head[8], (head[4] << 8) | head[5]);
+    TEST_ASSERT_TRUE(conn->tx.size() >= head[8]);
+    regs->clear();
+    for(uint8_t i = 0; i < head[8] / 2; i++){
+        uint16_t value = conn->tx[0] << 8 | conn->tx[1];
+        conn->tx.pop_front();
+        conn->tx.pop_front();
+        regs->push_back(value);
+    }
+    return 0;
+}
+
+static bool fromUnit(const std::vector<uint16_t> &regs, uint8_t unit, uint16_t addr, uint16_t count){
+    if(regs.size() != count){
+        return false;
+    }
+    for(uint16_t i = 0; i < count; i++){
+        if(regs[i] != unitValue(unit, addr + i)){
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Tests ---
+void setUp(void){
+    busCalls.clear();
+    // Nothing is served from the cache unless a test stores it
+    memset(cache, 0, sizeof(cache));
+}
+
+// Free the client slots for the next test
+void tearDown(void){
+    for(auto &conn : conns){
+        conn->open = false;
+    }
+    conns.clear();
+    mbGatewayLoop();
+}
+
+void test_invalid_requests_get_exceptions(void){
+    auto conn = connect();
+    request(conn, 1, METER_UNIT, 0x06, 0x0000, 1);
+    request(conn, 2, METER_UNIT, 0x03, 0x0000, 0);
+    request(conn, 3, METER_UNIT, 0x03, 0x0000, MB_GATEWAY_MAX_REGS + 1);
+    for(uint8_t i = 0; i < 3; i++){
+        mbGatewayLoop();
+    }
+    std::vector<uint16_t> regs;
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_ILLEGAL_FUNCTION, response(conn, 1, METER_UNIT, 0x06, &regs));
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_ILLEGAL_DATA_VALUE, response(conn, 2, METER_UNIT, 0x03, &regs));
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_ILLEGAL_DATA_VALUE, response(conn, 3, METER_UNIT, 0x03, &regs));
+    TEST_ASSERT_EQUAL_UINT32(0, busCalls.size());
+}
+
+// Unit 0 is a broadcast, nothing on the RTU side answers it
+void test_unit_0_is_gateway_target_failure(void){
+    auto conn = connect();
+    request(conn, 7, 0x00, 0x03, 0x5000, 2);
+    mbGatewayLoop();
+    std::vector<uint16_t> regs;
+    TEST_ASSERT_EQUAL_UINT8(MB_EX_GATEWAY_TARGET, response(conn, 7, 0x00, 0x03, &regs));
+    TEST_ASSERT_EQUAL_UINT32(0, busCalls.size());
+}
+
+// Unit 0xFF is the gateway itself, it reads the meter and echoes 0xFF
+void test_unit_ff_reads_the_meter(void){
+    auto conn = connect();
+    request(conn, 8, MB_GATEWAY_UNIT_THIS, 0x04, 0x5000, 4);
+    mbGatewayLoop();
+    std::vector<uint16_t> regs;
+    TEST_ASSERT_EQUAL_UINT8(0, response(conn, 8, MB_GATEWAY_UNIT_THIS, 0x04, &regs));
+    TEST_ASSERT_TRUE(fromUnit(regs, METER_UNIT, 0x5000, 4));
+    TEST_ASSERT_EQUAL_UINT32(1, busCalls.size());
+    TEST_ASSERT_EQUAL_UINT8(METER_UNIT, busCalls[0].unit);
+}
+
+void test_cache_hit_skips_the_bus(void){
+    uint8_t data[4];
+    rtuRead(METER_UNIT, 0x03, 0x6000, 2, data);
+    regCacheStore(METER_UNIT, 0x03, 0x6000, data, 2);
+    busCalls.clear();
+
+    auto conn = connect();
+    request(conn, 9, MB_GATEWAY_UNIT_THIS, 0x03, 0x6000, 2);
+    mbGatewayLoop();
+    std::vector<uint16_t> regs;
+    TEST_ASSERT_EQUAL_UINT8(0, response(conn, 9, MB_GATEWAY_UNIT_THIS, 0x03, &regs));
+    TEST_ASSERT_TRUE(fromUnit(regs, METER_UNIT, 0x6000, 2));
+    TEST_ASSERT_EQUAL_UINT32(0, busCalls.size());
+}
+
+// The meter asked for by its own id and by 0xFF is one RTU read, another unit is not merged
+void test_same_range_shares_one_read(void){
+    auto first = connect();
+    auto second = connect();
+    auto third = connect();
+    request(first, 10, METER_UNIT, 0x03, 0x5002, 8);
+    request(second, 11, MB_GATEWAY_UNIT_THIS, 0x03, 0x5002, 8);
+    request(third, 12, OTHER_UNIT, 0x03, 0x5002, 8);
+    mbGatewayLoop();
+    std::vector<uint16_t> regs;
+    TEST_ASSERT_EQUAL_UINT8(0, response(first, 10, METER_UNIT, 0x03, &regs));
+    TEST_ASSERT_TRUE(fromUnit(regs, METER_UNIT, 0x5002, 8));
+    TEST_ASSERT_EQUAL_UINT8(0, response(second, 11, MB_GATEWAY_UNIT_THIS, 0x03, &regs));
+    TEST_ASSERT_TRUE(fromUnit(regs, METER_UNIT, 0x5002, 8));
+    TEST_ASSERT_EQUAL_UINT8(0, response(third, 12, OTHER_UNIT, 0x03, &regs));
+    TEST_ASSERT_TRUE(fromUnit(regs, OTHER_UNIT, 0x5002, 8));
+    TEST_ASSERT_EQUAL_UINT32(2, busCalls.size());
+}
+
+int main(int argc, char **argv){
+    mbGatewayBegin(rtuRead, METER_UNIT);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_invalid_requests_get_exceptions);
+    RUN_TEST(test_unit_0_is_gateway_target_failure);
+    RUN_TEST(test_unit_ff_reads_the_meter);
+    RUN_TEST(test_cache_hit_skips_the_bus);
+    RUN_TEST(test_same_range_shares_one_read);
+    return UNITY_END();
+}
@@ -0,0 +1,472 @@
+/**
+ * @file test_main.cpp
+ * @author agent (agent@local)
+ * @brief Host tests of the block OTA: streaming decoder, CRC and uploads that are interrupted by
+ *        lost connections, bad blocks and resets
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ * Blocks are compressed here with the same greedy heatshrink encoder as tools/ota_upload.py, a
+ * fixed vector from the tool checks that both agree on the format.
+ */
+
+// --- Includes ---
+#include <unity.h>
+
+#define ESP32 1
+#include "espIOTLibFake.h"
+#include "espIOTLibOTA.cpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+// --- Defines ---
+// 40 full blocks and a short one, the last blocks are noise and go raw
+#define IMAGE_SIZE (40 * ESP_IOTLIB_OTA_BLOCK_SIZE + 1234)
+#define NOISE_SIZE (2 * ESP_IOTLIB_OTA_BLOCK_SIZE + 1234)
+#define HASH_CHAIN_LIMIT 32
+
+// --- Typedefs ---
+typedef struct {
+    bool raw;
+    uint32_t crc;
+    std::vector<uint8_t> body;
+} otaBlock;
+
+// --- Private Vars ---
+static const esp_partition_t ota0 = {0x010000, 0x180000, "ota_0"};
+static const esp_partition_t ota1 = {0x190000, 0x180000, "ota_1"};
+static std::vector<uint8_t> image;
+static uint32_t imageCrcAll;
+static std::vector<otaBlock> blocks;
+static std::mt19937 rng;
+
+// --- Private Functions ---
+static void putBits(std::vector<uint8_t> &out, uint32_t &bits, uint8_t &count, uint32_t value, uint8_t width){
+    bits = (bits << width) | value;
+    count += width;
+    while(count >= 8){
+        count -= 8;
+        out.push_back(bits >> count);
+    }
+    bits &= (1UL << count) - 1;
+}
+
+// Greedy heatshrink encoder, matches found through 2 byte hash chains (as tools/ota_upload.py)
+static std::vector<uint8_t> compress(const uint8_t *data, size_t len){
+    const size_t maxOffset = 1 << ESP_IOTLIB_OTA_WINDOW_BITS;
+    const size_t maxLength = 1 << ESP_IOTLIB_OTA_LOOKAHEAD_BITS;
+    const size_t minLength = (1 + ESP_IOTLIB_OTA_WINDOW_BITS + ESP_IOTLIB_OTA_LOOKAHEAD_BITS) / 9 + 1;
+    std::vector<int> head(1 << 16, -1);
+    std::vector<int> prev(len, -1);
+    std::vector<uint8_t> out;
+    uint32_t bits = 0;
+    uint8_t count = 0;
+    size_t pos = 0;
+    while(pos < len){
+        size_t bestLength = 0;
+        size_t bestOffset = 0;
+        if(pos + 1 < len){
+            int start = head[(data[pos] << 8) | data[pos + 1]];
+            for(uint8_t n = 0; start >= 0 && n < HASH_CHAIN_LIMIT && pos - start <= maxOffset; n++, start = prev[start]){
+                size_t length = 0;
+                while(length < maxLength && pos + length < len && data[start + length] == data[pos + length]){
+                    length++;
+                }
+                if(length > bestLength){
+                    bestLength = length;
+                    bestOffset = pos - start;
+                }
+            }
+        }
+        size_t step = 1;
+        if(bestLength >= minLength){
+            putBits(out, bits, count, 0, 1);
+            putBits(out, bits, count, bestOffset - 1, ESP_IOTLIB_OTA_WINDOW_BITS);
+            putBits(out, bits, count, bestLength - 1, ESP_IOTLIB_OTA_LOOKAHEAD_BITS);
+            step = bestLength;
+        } else {
+            putBits(out, bits, count, 1, 1);
+            putBits(out, bits, count, data[pos], 8);
+        }
+        for(size_t end = pos + step; pos < end; pos++){
+            if(pos + 1 < len){
+                int &chain = head[(data[pos] << 8) | data[pos + 1]];
+                prev[pos] = chain;
+                chain = pos;
+            }
+        }
+    }
+    if(count){
+        out.push_back(bits << (8 - count));
+    }
+    return out;
+}
+
+// Text like records with counters in between, then noise
+static void makeImage(){
+    std::mt19937 gen(1);
+    image.clear();
+    const char *words[] = {"voltage", "current", "power", "energy", "modbus", "rs485", "phase", "meter"};
+    while(image.size() < IMAGE_SIZE - NOISE_SIZE){
+        char record[48];
+        int len = snprintf(record, sizeof(record), "%s.%s=%u;", words[gen() % 8], words[gen() % 8], (unsigned)(gen() % 1000));
+        image.insert(image.end(), record, record + len);
+    }
+    image.resize(IMAGE_SIZE - NOISE_SIZE);
+    while(image.size() < IMAGE_SIZE){
+        image.push_back(gen());
+    }
+    imageCrcAll = espIOTLibOTACrc32(0, image.data(), image.size());
+
+    blocks.clear();
+    for(size_t offset = 0; offset < image.size(); offset += ESP_IOTLIB_OTA_BLOCK_SIZE){
+        size_t len = std::min<size_t>(ESP_IOTLIB_OTA_BLOCK_SIZE, image.size() - offset);
+        otaBlock blk;
+        blk.body = compress(&image[offset], len);
+        blk.raw = blk.body.size() >= len;
+        if(blk.raw){
+            blk.body.assign(&image[offset], &image[offset] + len);
+        }
+        blk.crc = espIOTLibOTACrc32(0, &image[offset], len);
+        blocks.push_back(blk);
+    }
+}
+
+// Value of a field of the last JSON response
+static std::string field(const char *key){
+    const std::string &body = fakeWebServer.body;
+    std::string tag = std::string("\"") + key + "\": ";
+    size_t pos = body.find(tag);
+    if(pos == std::string::npos){
+        return "";
+    }
+    pos += tag.size();
+    return body.substr(pos, body.find_first_of(",}", pos) - pos);
+}
+
+static void request(const char *uri, std::map<std::string, std::string> args = {}){
+    fakeWebServer.args = args;
+    fakeWebServer.code = 0;
+    fakeWebServer.handlers[uri]();
+}
+
+static void begin(uint32_t size, uint32_t crc){
+    request("/ota/begin", {{"size", std::to_string(size)}, {"crc", std::to_string(crc)}});
+}
+
+static uint32_t next(){
+    request("/ota/status");
+    return std::stoul(field("next"));
+}
+
+// Body in random pieces like TCP delivers it, the connection drops after cut bytes if cut >= 0
+static void sendBlock(uint32_t index, const otaBlock &blk, int cut = -1, bool badCrc = false){
+    fakeWebServer.args = {{"index", std::to_string(index)}, {"crc", std::to_string(blk.crc ^ (badCrc ? 1 : 0))}};
+    if(blk.raw){
+        fakeWebServer.args["raw"] = "1";
+    }
+    HTTPRaw &raw = fakeWebServer.rawData;
+    WebServer::THandlerFunction body = fakeWebServer.uploads["/ota/block"];
+    raw.status = RAW_START;
+    body();
+    size_t pos = 0;
+    while(pos < blk.body.size()){
+        if(cut >= 0 && pos >= (size_t)cut){
+            raw.status = RAW_ABORTED;
+            body();
+            return;
+        }
+        size_t len = std::min<size_t>(blk.body.size() - pos, 1 + rng() % HTTP_RAW_BUFLEN);
+        raw.status = RAW_WRITE;
+        raw.currentSize = len;
+        memcpy(raw.buf, &blk.body[pos], len);
+        body();
+        pos += len;
+    }
+    raw.status = RAW_END;
+    raw.currentSize = 0;
+    body();
+    request("/ota/block", fakeWebServer.args);
+}
+
+// Power cycle: RAM state is lost, flash and NVS stay
+static void reboot(){
+    active = false;
+    imageSize = 0;
+    imageCrc = 0;
+    nextBlock = 0;
+    lastBlockCrc = 0;
+    blockState = OTA_BLOCK_NONE;
+    fakeWebServer.handlers.clear();
+    fakeWebServer.uploads.clear();
+    espIOTLibEnableBlockOTA();
+}
+
+static bool imageInFlash(const esp_partition_t *part){
+    return memcmp(&fakeFlash[part->address], image.data(), image.size()) == 0;
+}
+
+// --- Tests ---
+void setUp(void){
+    rng.seed(7);
+    fakeNvs.clear();
+    std::fill(fakeFlash.begin(), fakeFlash.end(), 0xFF);
+    fakeNextPartition = &ota1;
+    fakeBootPartition = nullptr;
+    fakeWebServer.authorized = true;
+    reboot();
+}
+
+void tearDown(void){
+}
+
+void test_crc32(void){
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, espIOTLibOTACrc32(0, (const uint8_t *)"123456789", 9));
+    // Chained over pieces, as the finish check runs block by block
+    uint32_t crc = 0;
+    for(size_t offset = 0; offset < image.size(); offset += 1000){
+        crc = espIOTLibOTACrc32(crc, &image[offset], std::min<size_t>(1000, image.size() - offset));
+    }
+    TEST_ASSERT_EQUAL_HEX32(imageCrcAll, crc);
+}
+
+// Output of tools/ota_upload.py heatshrink_compress(text, 10, 5)
+void test_decoder_matches_upload_tool(void){
+    const char *text = "Modbus Modbus Modbus RTU, aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa!";
+    const uint8_t stream[] = {
+        0xA6, 0xDB, 0xEC, 0x96, 0x2B, 0xAD, 0xCE, 0x40, 0x01, 0x9B, 0x52, 0xAA, 0x55, 0x65, 0x92, 0x0B,
+        0x08, 0x00, 0xF8, 0x00, 0x34, 0x84
+    };
+    uint8_t out[80];
+    espIOTLibOTADecoder dec;
+    espIOTLibOTADecoderInit(&dec, out, strlen(text));
+    TEST_ASSERT_TRUE(espIOTLibOTADecoderFeed(&dec, stream, sizeof(stream)));
+    TEST_ASSERT_EQUAL_UINT16(strlen(text), dec.outLen);
+    TEST_ASSERT_EQUAL_MEMORY(text, out, strlen(text));
+    TEST_ASSERT_TRUE(compress((const uint8_t *)text, strlen(text)) == std::vector<uint8_t>(stream, stream + sizeof(stream)));
+}
+
+// Every block fed in single bytes, random pieces and at once
+void test_decoder_any_chunking(void){
+    uint8_t out[ESP_IOTLIB_OTA_BLOCK_SIZE];
+    uint32_t compressed = 0;
+    for(size_t i = 0; i < blocks.size(); i++){
+        if(blocks[i].raw){
+            continue;
+        }
+        compressed++;
+        const std::vector<uint8_t> &body = blocks[i].body;
+        size_t len = std::min<size_t>(ESP_IOTLIB_OTA_BLOCK_SIZE, image.size() - i * ESP_IOTLIB_OTA_BLOCK_SIZE);
+        for(uint8_t mode = 0; mode < 3; mode++){
+            espIOTLibOTADecoder dec;
+            espIOTLibOTADecoderInit(&dec, out, len);
+            size_t pos = 0;
+            while(pos < body.size()){
+                size_t piece = mode == 0 ? 1 : (mode == 1 ? 1 + rng() % 700 : body.size());
+                piece = std::min(piece, body.size() - pos);
+                TEST_ASSERT_TRUE(espIOTLibOTADecoderFeed(&dec, &body[pos], piece));
+                pos += piece;
+            }
+            TEST_ASSERT_EQUAL_UINT16(len, dec.outLen);
+            TEST_ASSERT_EQUAL_MEMORY(&image[i * ESP_IOTLIB_OTA_BLOCK_SIZE], out, len);
+        }
+    }
+    TEST_ASSERT_TRUE(compressed > 30);
+    TEST_ASSERT_TRUE(blocks.back().raw);
+}
+
+void test_decoder_rejects_bad_streams(void){
+    uint8_t out[ESP_IOTLIB_OTA_BLOCK_SIZE];
+    espIOTLibOTADecoder dec;
+    const std::vector<uint8_t> &body = blocks[0].body;
+    // More data than the block holds
+    espIOTLibOTADecoderInit(&dec, out, ESP_IOTLIB_OTA_BLOCK_SIZE - 1);
+    TEST_ASSERT_FALSE(espIOTLibOTADecoderFeed(&dec, body.data(), body.size()));
+    // Truncated stream decodes fine but comes out short
+    espIOTLibOTADecoderInit(&dec, out, ESP_IOTLIB_OTA_BLOCK_SIZE);
+    TEST_ASSERT_TRUE(espIOTLibOTADecoderFeed(&dec, body.data(), body.size() / 2));
+    TEST_ASSERT_TRUE(dec.outLen < ESP_IOTLIB_OTA_BLOCK_SIZE);
+    // Back reference before the start of the block
+    const uint8_t before[] = {0x00, 0x40};
+    espIOTLibOTADecoderInit(&dec, out, 100);
+    TEST_ASSERT_FALSE(espIOTLibOTADecoderFeed(&dec, before, sizeof(before)));
+    TEST_ASSERT_FALSE(espIOTLibOTADecoderFeed(&dec, body.data(), body.size()));
+    // Noise never writes past the end (checked by the sanitizers too)
+    for(uint16_t n = 0; n < 2000; n++){
+        uint8_t noise[600];
+        for(uint8_t &b : noise){
+            b = rng();
+        }
+        uint16_t size = 1 + rng() % ESP_IOTLIB_OTA_BLOCK_SIZE;
+        espIOTLibOTADecoderInit(&dec, out, size);
+        espIOTLibOTADecoderFeed(&dec, noise, sizeof(noise));
+        TEST_ASSERT_TRUE(dec.outLen <= size);
+    }
+}
+
+void test_needs_authentication(void){
+    fakeWebServer.authorized = false;
+    begin(image.size(), imageCrcAll);
+    TEST_ASSERT_EQUAL_INT(401, fakeWebServer.code);
+    request("/ota/status");
+    TEST_ASSERT_EQUAL_INT(401, fakeWebServer.code);
+    TEST_ASSERT_TRUE(fakeNvs.empty());
+}
+
+// A block without credentials is neither decoded nor written
+void test_block_body_needs_authentication(void){
+    begin(image.size(), imageCrcAll);
+    sendBlock(0, blocks[0]);
+    TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    std::vector<uint8_t> buffered(block, block + sizeof(block));
+    std::vector<uint8_t> flash(fakeFlash.begin() + ota1.address, fakeFlash.begin() + ota1.address + 2 * ESP_IOTLIB_OTA_BLOCK_SIZE);
+
+    fakeWebServer.authorized = false;
+    sendBlock(1, blocks[1]);
+    TEST_ASSERT_EQUAL_INT(401, fakeWebServer.code);
+    TEST_ASSERT_TRUE(memcmp(buffered.data(), block, sizeof(block)) == 0);
+    TEST_ASSERT_TRUE(std::equal(flash.begin(), flash.end(), fakeFlash.begin() + ota1.address));
+
+    fakeWebServer.authorized = true;
+    TEST_ASSERT_EQUAL_UINT32(1, next());
+    sendBlock(1, blocks[1]);
+    TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    TEST_ASSERT_EQUAL_UINT32(2, next());
+}
+
+// Lost connections, a bad block, a gap and a lost response, then the image is booted
+void test_upload_continues_after_errors(void){
+    uint32_t restarts = ESP.restarts;
+    begin(image.size(), imageCrcAll);
+    TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    TEST_ASSERT_EQUAL_STRING(std::to_string(blocks.size()).c_str(), field("blocks").c_str());
+    TEST_ASSERT_EQUAL_UINT32(0, next());
+    for(uint32_t i = 0; i < 10; i++){
+        sendBlock(i, blocks[i]);
+        TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    }
+    // Connection lost in the middle of a block
+    sendBlock(10, blocks[10], blocks[10].body.size() / 2);
+    TEST_ASSERT_EQUAL_UINT32(10, next());
+    sendBlock(10, blocks[10], -1, true);
+    TEST_ASSERT_EQUAL_INT(400, fakeWebServer.code);
+    TEST_ASSERT_EQUAL_STRING("\"block crc\"", field("error").c_str());
+    sendBlock(12, blocks[12]);
+    TEST_ASSERT_EQUAL_INT(409, fakeWebServer.code);
+    // The response to block 9 got lost, the client sends it again
+    sendBlock(9, blocks[9]);
+    TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    TEST_ASSERT_EQUAL_UINT32(10, next());
+    request("/ota/finish");
+    TEST_ASSERT_EQUAL_INT(409, fakeWebServer.code);
+
+    for(uint32_t i = next(); i < blocks.size(); i++){
+        sendBlock(i, blocks[i]);
+        TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    }
+    TEST_ASSERT_EQUAL_STRING("\"complete\"", field("state").c_str());
+    request("/ota/finish");
+    TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    TEST_ASSERT_TRUE(fakeBootPartition == &ota1);
+    TEST_ASSERT_TRUE(imageInFlash(&ota1));
+    TEST_ASSERT_TRUE(fakeNvs.empty());
+    TEST_ASSERT_EQUAL_UINT32(restarts + 1, ESP.restarts);
+}
+
+// Reset right after NVS said the block was written, but before flash had all of it
+void test_resume_after_torn_block(void){
+    begin(image.size(), imageCrcAll);
+    for(uint32_t i = 0; i < 20; i++){
+        sendBlock(i, blocks[i]);
+    }
+    memset(&fakeFlash[ota1.address + 19 * ESP_IOTLIB_OTA_BLOCK_SIZE + 1000], 0xFF, 3000);
+    reboot();
+    TEST_ASSERT_EQUAL_UINT32(19, next());
+    TEST_ASSERT_EQUAL_STRING("\"receiving\"", field("state").c_str());
+    TEST_ASSERT_EQUAL_HEX32(blocks[18].crc, lastBlockCrc);
+    // Another reset before block 19 is sent again changes nothing
+    reboot();
+    TEST_ASSERT_EQUAL_UINT32(19, next());
+    // The client starts again with the same image and continues
+    begin(image.size(), imageCrcAll);
+    TEST_ASSERT_EQUAL_UINT32(19, next());
+    for(uint32_t i = 19; i < blocks.size(); i++){
+        // Drop every 7th block once, continue where the device says
+        if(i % 7 == 0){
+            sendBlock(i, blocks[i], 50);
+            reboot();
+            TEST_ASSERT_EQUAL_UINT32(i, next());
+        }
+        sendBlock(i, blocks[i]);
+        TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    }
+    request("/ota/finish");
+    TEST_ASSERT_EQUAL_INT(200, fakeWebServer.code);
+    TEST_ASSERT_TRUE(imageInFlash(&ota1));
+}
+
+// After an update was booted, the next upload goes to the other slot, the saved state is void
+void test_resume_state_tied_to_partition(void){
+    begin(image.size(), imageCrcAll);
+    for(uint32_t i = 0; i < 5; i++){
+        sendBlock(i, blocks[i]);
+    }
+    reboot();
+    TEST_ASSERT_EQUAL_UINT32(5, next());
+
+    fakeNextPartition = &ota0;
+    reboot();
+    TEST_ASSERT_EQUAL_UINT32(0, next());
+    TEST_ASSERT_EQUAL_STRING("\"idle\"", field("state").c_str());
+    TEST_ASSERT_TRUE(fakeNvs.empty());
+    begin(image.size(), imageCrcAll);
+    TEST_ASSERT_EQUAL_UINT32(0, next());
+    TEST_ASSERT_EQUAL_UINT32(ota0.address, fakeNvs["espiotota/part"]);
+}
+
+void test_other_image_starts_over(void){
+    begin(image.size(), imageCrcAll);
+    for(uint32_t i = 0; i < 3; i++){
+        sendBlock(i, blocks[i]);
+    }
+    begin(image.size(), imageCrcAll ^ 1);
+    TEST_ASSERT_EQUAL_UINT32(0, next());
+    request("/ota/abort");
+    TEST_ASSERT_EQUAL_STRING("\"idle\"", field("state").c_str());
+    TEST_ASSERT_TRUE(fakeNvs.empty());
+    sendBlock(0, blocks[0]);
+    TEST_ASSERT_EQUAL_INT(409, fakeWebServer.code);
+}
+
+// All blocks fine but the announced image CRC is not the image's
+void test_image_crc_mismatch_starts_over(void){
+    begin(image.size(), imageCrcAll ^ 1);
+    for(uint32_t i = 0; i < blocks.size(); i++){
+        sendBlock(i, blocks[i]);
+    }
+    request("/ota/finish");
+    TEST_ASSERT_EQUAL_INT(409, fakeWebServer.code);
+    TEST_ASSERT_TRUE(fakeBootPartition == nullptr);
+    TEST_ASSERT_EQUAL_UINT32(0, next());
+}
+
+int main(int argc, char **argv){
+    makeImage();
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32);
+    RUN_TEST(test_decoder_matches_upload_tool);
+    RUN_TEST(test_decoder_any_chunking);
+    RUN_TEST(test_decoder_rejects_bad_streams);
+    RUN_TEST(test_needs_authentication);
+    RUN_TEST(test_block_body_needs_authentication);
+    RUN_TEST(test_upload_continues_after_errors);
+    RUN_TEST(test_resume_after_torn_block);
+    RUN_TEST(test_resume_state_tied_to_partition);
+    RUN_TEST(test_other_image_starts_over);
+    RUN_TEST(test_image_crc_mismatch_starts_over);
+    return UNITY_END();
+}
@@ -0,0 +1,385 @@
+/**
+ * @file test_main.cpp
+ * @author agent (agent@local)
+ * @brief Host tests of the register block decoder: all types and orders, out of range values
+ *        and a throughput comparison with the per-value float path it replaced
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) agent 2026
+ *
+ */
+
+// --- Includes ---
+#include <unity.h>
+
+#include "regDecode.cpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+// --- Defines ---
+#define RANDOM_VALUES 100000
+// The meter's poll: 22 float32 values
+#define BENCH_VALUES 22
+#define BENCH_ROUNDS 200000
+// Best of this many timed runs for the pass / fail comparison
+#define BENCH_REPEATS 5
+// With optimization both meter paths compile to the same loop, their best times still differ this much
+#define BENCH_NOISE 1.25
+
+// --- Private Vars ---
+// main.cpp's meter: values in publish order, read as three blocks stored back to back
+static const uint16_t meterAddrs[BENCH_VALUES] = {
+    0x500C, 0x500E, 0x5010, 0x5002, 0x5004, 0x5006, 0x5014, 0x5016, 0x5018, 0x5012, 0x5008,
+    0x502C, 0x502E, 0x5030,
+    0x6000, 0x6006, 0x6008, 0x600A, 0x600C, 0x6012, 0x6014, 0x6016,
+};
+static const uint16_t meterBlocks[][2] = {{0x5002, 24}, {0x502C, 6}, {0x6000, 24}};
+#define METER_BLOCK_REGS (24 + 6 + 24)
+
+// --- Private Functions ---
+// Put the width bytes of value (most significant first) on the wire in order
+static void encode(const uint8_t *value, uint8_t width, uint8_t order, uint8_t *wire){
+    for(uint8_t k = 0; k < width; k++){
+        uint8_t pos;
+        switch(order){
+        case REG_ORDER_CDAB:
+            pos = (width - 2 - (k & ~1)) | (k & 1);
+            break;
+        case REG_ORDER_BADC:
+            pos = k ^ 1;
+            break;
+        case REG_ORDER_DCBA:
+            pos = width - 1 - k;
+            break;
+        default:
+            pos = k;
+            break;
+        }
+        wire[pos] = value[k];
+    }
+}
+
+// Value of the width bytes (most significant first) as type
+static double reference(const uint8_t *value, uint8_t type){
+    uint64_t raw = 0;
+    for(uint8_t k = 0; k < 2 * regDecodeWidth(type); k++){
+        raw = (raw << 8) | value[k];
+    }
+    switch(type){
+    case REG_TYPE_INT16:
+        return (int16_t)raw;
+    case REG_TYPE_INT32:
+        return (int32_t)raw;
+    case REG_TYPE_FLOAT32: {
+        uint32_t bits = raw;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+    default:
+        return (double)raw;
+    }
+}
+
+// Encode value behind one padding register and check regDecode() (and regDecodeFloat32()) against the reference
+static bool checkValue(const uint8_t *value, uint8_t type, uint8_t order){
+    uint8_t width = 2 * regDecodeWidth(type);
+    uint8_t wire[2 + 8] = {0xAA, 0x55};
+    encode(value, width, order, wire + 2);
+    regDesc desc = {1, type, order, 1.0f};
+    double decoded;
+    regDecode(wire, 1 + width / 2, &desc, 1, &decoded);
+    double expected = reference(value, type);
+    if(isnan(expected)){
+        if(!isnan(decoded)){
+            return false;
+        }
+    } else if(decoded != expected){
+        return false;
+    }
+    if(type == REG_TYPE_FLOAT32){
+        // Batch path keeps the exact bits, also of NaNs
+        float batch;
+        uint32_t bits = 0;
+        regDecodeFloat32(wire + 2, 1, order, &batch);
+        for(uint8_t k = 0; k < 4; k++){
+            bits = (bits << 8) | value[k];
+        }
+        return memcmp(&batch, &bits, sizeof(bits)) == 0;
+    }
+    return true;
+}
+
+// Float conversion of the per-value reads regDecode() replaced (main.cpp getFloat())
+static float perValueFloat(const uint8_t *fBuf){
+    uint8_t fBuf2[4];
+    fBuf2[0] = fBuf[3];
+    fBuf2[1] = fBuf[2];
+    fBuf2[2] = fBuf[1];
+    fBuf2[3] = fBuf[0];
+    float f;
+    memcpy(&f, fBuf2, sizeof(f));
+    return f;
+}
+
+// Same placement as main.cpp meterLayout()
+static void meterLayout(uint16_t *offsets){
+    for(uint8_t i = 0; i < BENCH_VALUES; i++){
+        uint16_t start = 0;
+        for(uint8_t b = 0; b < sizeof(meterBlocks) / sizeof(meterBlocks[0]); b++){
+            if(meterAddrs[i] >= meterBlocks[b][0] && meterAddrs[i] + 2 <= meterBlocks[b][0] + meterBlocks[b][1]){
+                offsets[i] = start + meterAddrs[i] - meterBlocks[b][0];
+                break;
+            }
+            start += meterBlocks[b][1];
+        }
+    }
+}
+
+// ns per value of decoding the meter's layout value by value, as getFloat() did
+static double benchMeterPerValue(uint8_t *block, const uint16_t *offsets, float *values){
+    volatile float sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for(uint32_t r = 0; r < BENCH_ROUNDS; r++){
+        block[0] = r;
+        for(uint8_t i = 0; i < BENCH_VALUES; i++){
+            values[i] = perValueFloat(block + 2 * offsets[i]);
+        }
+        sink = sink + values[r % BENCH_VALUES];
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_ROUNDS / BENCH_VALUES;
+}
+
+// ns per value of meterPublish()'s decode
+static double benchMeterDecode(uint8_t *block, const uint16_t *offsets, float *values){
+    volatile float sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for(uint32_t r = 0; r < BENCH_ROUNDS; r++){
+        block[0] = r;
+        regDecodeFloat32Gather(block, offsets, BENCH_VALUES, REG_ORDER_ABCD, values);
+        sink = sink + values[r % BENCH_VALUES];
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_ROUNDS / BENCH_VALUES;
+}
+
+// --- Tests ---
+void setUp(void){
+    srand(1);
+}
+
+void tearDown(void){
+}
+
+void test_float32_all_orders(void){
+    // 230.5 = 0x43668000
+    const uint8_t wire[4][4] = {
+        {0x43, 0x66, 0x80, 0x00},   // ABCD
+        {0x80, 0x00, 0x43, 0x66},   // CDAB
+        {0x66, 0x43, 0x00, 0x80},   // BADC
+        {0x00, 0x80, 0x66, 0x43},   // DCBA
+    };
+    for(uint8_t order = REG_ORDER_ABCD; order <= REG_ORDER_DCBA; order++){
+        regDesc desc = {0, REG_TYPE_FLOAT32, order, 1.0f};
+        double value;
+        float batch;
+        regDecode(wire[order], 2, &desc, 1, &value);
+        regDecodeFloat32(wire[order], 1, order, &batch);
+        TEST_ASSERT_TRUE(value == 230.5);
+        TEST_ASSERT_EQUAL_FLOAT(230.5f, batch);
+        // Same value at offsets 1 and 4, behind and between padding registers
+        uint8_t padded[12] = {0xAA, 0x55};
+        memcpy(padded + 2, wire[order], 4);
+        memcpy(padded + 8, wire[order], 4);
+        const uint16_t offsets[2] = {1, 4};
+        float gathered[2];
+        regDecodeFloat32Gather(padded, offsets, 2, order, gathered);
+        TEST_ASSERT_EQUAL_FLOAT(230.5f, gathered[0]);
+        TEST_ASSERT_EQUAL_FLOAT(230.5f, gathered[1]);
+    }
+}
+
+void test_integer_types_and_scale(void){
+    const uint8_t word[2] = {0xFF, 0xFE};
+    const uint8_t dword[4] = {0xFF, 0xFF, 0xFF, 0xFD};
+    const uint8_t qword[8] = {0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02};
+    regDesc desc = {0, REG_TYPE_INT16, REG_ORDER_ABCD, 1.0f};
+    double value;
+
+    regDecode(word, 1, &desc, 1, &value);
+    TEST_ASSERT_TRUE(value == -2.0);
+    desc.type = REG_TYPE_UINT16;
+    regDecode(word, 1, &desc, 1, &value);
+    TEST_ASSERT_TRUE(value == 65534.0);
+
+    desc.type = REG_TYPE_INT32;
+    desc.scale = 0.5f;
+    regDecode(dword, 2, &desc, 1, &value);
+    TEST_ASSERT_TRUE(value == -1.5);
+    desc.type = REG_TYPE_UINT32;
+    desc.scale = 1.0f;
+    regDecode(dword, 2, &desc, 1, &value);
+    TEST_ASSERT_TRUE(value == 4294967293.0);
+
+    desc.type = REG_TYPE_UINT64;
+    regDecode(qword, 4, &desc, 1, &value);
+    TEST_ASSERT_TRUE(value == 4294967298.0);
+    desc.order = REG_ORDER_CDAB;
+    regDecode(qword, 4, &desc, 1, &value);
+    TEST_ASSERT_TRUE(value == (double)0x0002000000010000ULL);
+}
+
+void test_out_of_range_is_nan(void){
+    uint8_t block[8] = {0};
+    double value;
+    for(uint8_t type = REG_TYPE_UINT16; type <= REG_TYPE_UINT64; type++){
+        const uint16_t offsets[] = {(uint16_t)(5 - regDecodeWidth(type)), 4, 100, 0xFFFF};
+        for(uint8_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++){
+            regDesc desc = {offsets[o], type, REG_ORDER_ABCD, 1.0f};
+            regDecode(block, 4, &desc, 1, &value);
+            TEST_ASSERT_TRUE(isnan(value));
+        }
+        // Last value that fits
+        regDesc desc = {(uint16_t)(4 - regDecodeWidth(type)), type, REG_ORDER_ABCD, 1.0f};
+        regDecode(block, 4, &desc, 1, &value);
+        TEST_ASSERT_TRUE(value == 0.0);
+    }
+}
+
+void test_16bit_exhaustive(void){
+    for(uint8_t type = REG_TYPE_UINT16; type <= REG_TYPE_INT16; type++){
+        for(uint8_t order = REG_ORDER_ABCD; order <= REG_ORDER_DCBA; order++){
+            for(uint32_t v = 0; v <= 0xFFFF; v++){
+                uint8_t value[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+                if(!checkValue(value, type, order)){
+                    char msg[64];
+                    snprintf(msg, sizeof(msg), "type %u order %u value 0x%04X", type, order, v);
+                    TEST_FAIL_MESSAGE(msg);
+                }
+            }
+        }
+    }
+}
+
+// Every byte value in every position, then random values
+void test_wide_types_every_byte_and_random(void){
+    for(uint8_t type = REG_TYPE_UINT32; type <= REG_TYPE_UINT64; type++){
+        uint8_t width = 2 * regDecodeWidth(type);
+        for(uint8_t order = REG_ORDER_ABCD; order <= REG_ORDER_DCBA; order++){
+            for(uint8_t pos = 0; pos < width; pos++){
+                for(uint16_t b = 0; b < 256; b++){
+                    uint8_t value[8] = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0};
+                    value[pos] = b;
+                    TEST_ASSERT_TRUE(checkValue(value, type, order));
+                }
+            }
+            for(uint32_t n = 0; n < RANDOM_VALUES; n++){
+                uint8_t value[8];
+                for(uint8_t k = 0; k < width; k++){
+                    value[k] = rand();
+                }
+                TEST_ASSERT_TRUE(checkValue(value, type, order));
+            }
+        }
+    }
+}
+
+void test_matches_per_value_path(void){
+    for(uint32_t n = 0; n < RANDOM_VALUES; n++){
+        uint8_t wire[4];
+        for(uint8_t k = 0; k < 4; k++){
+            wire[k] = rand();
+        }
+        float old = perValueFloat(wire);
+        float batch;
+        regDecodeFloat32(wire, 1, REG_ORDER_ABCD, &batch);
+        TEST_ASSERT_EQUAL_MEMORY(&old, &batch, sizeof(float));
+    }
+}
+
+// The numbers depend on the host and build flags, only the meter layout comparison must hold
+void test_throughput(void){
+    uint8_t block[4 * BENCH_VALUES];
+    regDesc desc[BENCH_VALUES];
+    float perValue[BENCH_VALUES];
+    float batch[BENCH_VALUES];
+    double decoded[BENCH_VALUES];
+    volatile float sink = 0;
+    for(uint16_t i = 0; i < sizeof(block); i++){
+        block[i] = rand() & 0x7F;
+    }
+    for(uint8_t i = 0; i < BENCH_VALUES; i++){
+        desc[i] = {(uint16_t)(2 * i), REG_TYPE_FLOAT32, REG_ORDER_ABCD, 1.0f};
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(uint32_t r = 0; r < BENCH_ROUNDS; r++){
+        block[0] = r;
+        for(uint8_t i = 0; i < BENCH_VALUES; i++){
+            perValue[i] = perValueFloat(block + 4 * i);
+        }
+        sink = sink + perValue[r % BENCH_VALUES];
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for(uint32_t r = 0; r < BENCH_ROUNDS; r++){
+        block[0] = r;
+        regDecode(block, 2 * BENCH_VALUES, desc, BENCH_VALUES, decoded);
+        sink = sink + decoded[r % BENCH_VALUES];
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    for(uint32_t r = 0; r < BENCH_ROUNDS; r++){
+        block[0] = r;
+        regDecodeFloat32(block, BENCH_VALUES, REG_ORDER_ABCD, batch);
+        sink = sink + batch[r % BENCH_VALUES];
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    for(uint8_t i = 0; i < BENCH_VALUES; i++){
+        TEST_ASSERT_EQUAL_MEMORY(&perValue[i], &batch[i], sizeof(float));
+        TEST_ASSERT_TRUE(decoded[i] == batch[i]);
+    }
+    const double values = (double)BENCH_ROUNDS * BENCH_VALUES;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "ns/value: per-value %.2f, regDecode %.2f, regDecodeFloat32 %.2f",
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / values,
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / values,
+        std::chrono::duration<double, std::nano>(t3 - t2).count() / values);
+    TEST_MESSAGE(msg);
+
+    // The production call must not be slower than the per-value path it replaced (at -Og, which pio test
+    // builds with, it is about a quarter faster)
+    uint8_t meterBlock[2 * METER_BLOCK_REGS];
+    uint16_t meterOffsets[BENCH_VALUES];
+    for(uint16_t i = 0; i < sizeof(meterBlock); i++){
+        meterBlock[i] = rand() & 0x7F;
+    }
+    meterLayout(meterOffsets);
+    double perValueNs = INFINITY;
+    double decodeNs = INFINITY;
+    for(uint8_t n = 0; n < BENCH_REPEATS; n++){
+        perValueNs = fmin(perValueNs, benchMeterPerValue(meterBlock, meterOffsets, perValue));
+        decodeNs = fmin(decodeNs, benchMeterDecode(meterBlock, meterOffsets, batch));
+    }
+    for(uint8_t i = 0; i < BENCH_VALUES; i++){
+        TEST_ASSERT_EQUAL_MEMORY(&perValue[i], &batch[i], sizeof(float));
+    }
+    snprintf(msg, sizeof(msg), "meter layout ns/value: per-value %.2f, meterPublish() %.2f", perValueNs, decodeNs);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(decodeNs <= perValueNs * BENCH_NOISE);
+}
+
+int main(int argc, char **argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_float32_all_orders);
+    RUN_TEST(test_integer_types_and_scale);
+    RUN_TEST(test_out_of_range_is_nan);
+    RUN_TEST(test_16bit_exhaustive);
+    RUN_TEST(test_wide_types_every_byte_and_random);
+    RUN_TEST(test_matches_per_value_path);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""
+Resumable, compressed OTA upload for espIOTLib devices (/ota endpoints, see espIOTLibOTA.h).
+
+The firmware image is cut into blocks, every block is heatshrink compressed on its own and sent
+with the CRC32 of its data. After a failed request the upload continues at the block the device
+reports as next, also when the script is started again for the same image.
+
+    python3 tools/ota_upload.py 192.168.4.1 .pio/build/lolin_s2_mini/firmware.bin -p <AP password>
+"""
+
+import argparse
+import base64
+import json
+import sys
+import time
+import urllib.error
+import urllib.request
+import zlib
+
+HASH_CHAIN_LIMIT = 32
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.bits = 0
+        self.count = 0
+
+    def put(self, value, width):
+        self.bits = (self.bits << width) | value
+        self.count += width
+        while self.count >= 8:
+            self.count -= 8
+            self.out.append((self.bits >> self.count) & 0xFF)
+        self.bits &= (1 << self.count) - 1
+
+    def finish(self):
+        if self.count:
+            self.out.append((self.bits << (8 - self.count)) & 0xFF)
+        return bytes(self.out)
+
+
+def heatshrink_compress(data, window_bits, lookahead_bits):
+    """Greedy heatshrink encoder, matches found through 2 byte hash chains."""
+    max_offset = 1 << window_bits
+    max_length = 1 << lookahead_bits
+    # A back reference only pays off if it is shorter than the literals it replaces
+    min_length = (1 + window_bits + lookahead_bits) // 9 + 1
+    chains = {}
+    out = BitWriter()
+    pos = 0
+    while pos < len(data):
+        best_length = 0
+        best_offset = 0
+        candidates = chains.get(data[pos:pos + 2], [])
+        for start in reversed(candidates[-HASH_CHAIN_LIMIT:]):
+            offset = pos - start
+            if offset > max_offset:
+                break
+            length = 0
+            while (length < max_length and pos + length < len(data)
+                   and data[start + length] == data[pos + length]):
+                length += 1
+            if length > best_length:
+                best_length = length
+                best_offset = offset
+                if length == max_length:
+                    break
+        if best_length >= min_length:
+            out.put(0, 1)
+            out.put(best_offset - 1, window_bits)
+            out.put(best_length - 1, lookahead_bits)
+            step = best_length
+        else:
+            out.put(1, 1)
+            out.put(data[pos], 8)
+            step = 1
+        for i in range(pos, pos + step):
+            chains.setdefault(data[i:i + 2], []).append(i)
+        pos += step
+    return out.finish()
+
+
+class Device:
+    def __init__(self, host, user, password, timeout):
+        self.base = "http://%s/ota" % host
+        token = base64.b64encode(("%s:%s" % (user, password)).encode()).decode()
+        self.headers = {"Authorization": "Basic " + token}
+        self.timeout = timeout
+
+    def request(self, path, body=None, method="POST"):
+        headers = dict(self.headers)
+        if body is not None:
+            headers["Content-Type"] = "application/octet-stream"
+        req = urllib.request.Request(self.base + path, data=body if body is not None else b"",
+                                     headers=headers, method=method)
+        try:
+            with urllib.request.urlopen(req, timeout=self.timeout) as resp:
+                return json.load(resp)
+        except urllib.error.HTTPError as err:
+            status = json.load(err) if err.headers.get("Content-Type") == "application/json" else {}
+            raise RuntimeError("%s: HTTP %d %s" % (path, err.code, status.get("error", "")))
+
+    def status(self):
+        return self.request("/status", method="GET")
+
+
+def upload(dev, image, retries):
+    crc = zlib.crc32(image)
+    status = dev.request("/begin?size=%d&crc=%d" % (len(image), crc))
+    block_size = status["blockSize"]
+    window_bits = status["window"]
+    lookahead_bits = status["lookahead"]
+    blocks = status["blocks"]
+    if status["next"]:
+        print("resuming at block %d of %d" % (status["next"], blocks))
+
+    sent = 0
+    started = time.time()
+    failures = 0
+    index = status["next"]
+    while index < blocks:
+        data = image[index * block_size:(index + 1) * block_size]
+        body = heatshrink_compress(data, window_bits, lookahead_bits)
+        raw = len(body) >= len(data)
+        path = "/block?index=%d&crc=%d%s" % (index, zlib.crc32(data), "&raw=1" if raw else "")
+        try:
+            status = dev.request(path, data if raw else body)
+            failures = 0
+        except (OSError, RuntimeError) as err:
+            failures += 1
+            if failures > retries:
+                raise
+            print("block %d failed (%s), asking the device where to go on" % (index, err))
+            time.sleep(min(2 ** failures, 30))
+            try:
+                status = dev.status()
+            except OSError:
+                continue
+        sent += len(data) if raw else len(body)
+        index = status["next"]
+        print("\r%d/%d blocks, %d of %d bytes sent" % (index, blocks, sent, len(image)), end="")
+    print()
+
+    dev.request("/finish")
+    print("done in %.1f s, device restarts" % (time.time() - started))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host")
+    parser.add_argument("image")
+    parser.add_argument("-u", "--user", default="admin")
+    parser.add_argument("-p", "--password", required=True, help="AP password of the device")
+    parser.add_argument("-r", "--retries", type=int, default=10, help="failed requests in a row before giving up")
+    parser.add_argument("-t", "--timeout", type=float, default=20)
+    parser.add_argument("--abort", action="store_true", help="forget a pending upload on the device")
+    args = parser.parse_args()
+
+    dev = Device(args.host, args.user, args.password, args.timeout)
+    if args.abort:
+        dev.request("/abort")
+        return 0
+    with open(args.image, "rb") as f:
+        image = f.read()
+    upload(dev, image, args.retries)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())